@@ -0,0 +1,117 @@
+// Step time of the flocking simulation for several thread counts, storage modes, precisions and neighbor indices.
+// usage: flocking-bench [boids] [threads...]   default 100000 boids, 1 2 4 8 16 32 threads
+// results are written to stdout as JSON
+#include "flocking.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// half the boids spread evenly, half packed in a few clusters, so some chunks cost far more than others
+static std::vector<Boid> makeFlock(int count) {
+  std::mt19937 generator(2024);
+  // mt19937 output is fully specified, unlike the <random> distributions, so every platform gets this flock
+  auto unit = [&]() { return generator() / 4294967296.0; };
+  const double side = std::sqrt((double)count) * 2;
+  std::vector<Boid> boids;
+  for (int i = 0; i < count; i++) {
+    Vector2 position(unit() * side, unit() * side);
+    if (i % 2 == 1) {
+      const int cluster = i % 10;
+      position = Vector2(side * (0.1 + 0.08 * cluster) + unit() * 30, side * 0.5 + unit() * 30);
+    }
+    boids.emplace_back(position, Vector2(unit() * 2 - 1, unit() * 2 - 1));
+  }
+  return boids;
+}
+
+template <typename T>
+static double millisecondsPerStep(BasicFlocking<T> flocking, int steps) {
+  flocking.Step(0.01); // warm up: grid buffers, thread start
+  auto start = Clock::now();
+  for (int i = 0; i < steps; i++) flocking.Step(0.01);
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / steps;
+}
+
+enum class Index { Grid, Quadtree, Verlet };
+
+struct Configuration {
+  const char* storage;
+  const char* index;
+  bool single, arrays;
+  Index neighbors;
+  int reorderInterval = 0;
+};
+
+template <typename T>
+static double millisecondsPerStep(const Configuration& configuration, const std::vector<BasicBoid<T>>& boids, int threads) {
+  BasicFlocking<T> flocking(3, 1, 2, 2, 1, 1.5, 0.5, boids);
+  using Flock = BasicFlocking<T>;
+  flocking.storage = configuration.arrays ? Flock::Storage::StructOfArrays : Flock::Storage::ArrayOfStructs;
+  switch (configuration.neighbors) {
+    case Index::Grid: flocking.neighborIndex = Flock::NeighborIndex::UniformGrid; break;
+    case Index::Quadtree: flocking.neighborIndex = Flock::NeighborIndex::Quadtree; break;
+    // with the default skin a boid at speed 1 takes 25 steps to force a rebuild: the timed steps reuse the lists
+    case Index::Verlet: flocking.neighborIndex = Flock::NeighborIndex::VerletLists; break;
+  }
+  flocking.reorderInterval = configuration.reorderInterval;
+  flocking.SetThreads(threads);
+  return millisecondsPerStep(flocking, 5);
+}
+
+int main(int argc, char** argv) {
+  int count = argc > 1 ? std::stoi(argv[1]) : 100000;
+  std::vector<int> threads;
+  for (int i = 2; i < argc; i++) threads.push_back(std::stoi(argv[i]));
+  if (threads.empty()) threads = {1, 2, 4, 8, 16, 32};
+
+  const auto boids = makeFlock(count);
+  std::vector<BasicBoid<float>> floats;
+  for (const Boid& boid : boids) {
+    floats.emplace_back(BasicVector2<float>(boid.position.x, boid.position.y), BasicVector2<float>(boid.velocity.x, boid.velocity.y));
+  }
+  // more threads than the machine has only time the scheduling overhead, their speedups are not scaling numbers
+  const unsigned hardwareThreads = std::thread::hardware_concurrency();
+  if (*std::max_element(threads.begin(), threads.end()) > (int)hardwareThreads) {
+    std::cerr << "warning: only " << hardwareThreads << " hardware threads, rows marked oversubscribed do not measure scaling" << std::endl;
+  }
+  std::cout << "{\n  \"benchmark\": \"flocking\",\n  \"boids\": " << count
+            << ",\n  \"hardware_threads\": " << hardwareThreads << ",\n  \"results\": [\n";
+  const Configuration configurations[] = {
+      {"array_of_structs", "grid", false, false, Index::Grid},
+      {"struct_of_arrays", "grid", false, true, Index::Grid},
+      {"float_array_of_structs", "grid", true, false, Index::Grid},
+      {"float_struct_of_arrays", "grid", true, true, Index::Grid},
+      {"array_of_structs", "quadtree", false, false, Index::Quadtree},
+      {"struct_of_arrays", "quadtree", false, true, Index::Quadtree},
+      {"array_of_structs", "verlet", false, false, Index::Verlet},
+      // the bench flock is in random order, as a long run ends up
+      {"array_of_structs", "grid", false, false, Index::Grid, 1},
+      {"struct_of_arrays", "grid", false, true, Index::Grid, 1},
+  };
+  const size_t configurationCount = std::size(configurations);
+  for (size_t c = 0; c < configurationCount; c++) {
+    const Configuration& configuration = configurations[c];
+    // speedups are relative to the first thread count, 1 by default
+    double first = 0;
+    for (size_t t = 0; t < threads.size(); t++) {
+      std::cerr << "running " << configuration.storage << " on the " << configuration.index << " with " << threads[t] << " threads..." << std::endl;
+      const double ms = configuration.single ? millisecondsPerStep(configuration, floats, threads[t]) : millisecondsPerStep(configuration, boids, threads[t]);
+      if (t == 0) first = ms;
+      std::cout << "    {\"storage\": \"" << configuration.storage << "\", \"index\": \"" << configuration.index << "\", \"reorder_interval\": " << configuration.reorderInterval
+                << ", \"threads\": " << threads[t] << ", \"oversubscribed\": " << (threads[t] > (int)hardwareThreads ? "true" : "false")
+                << ", \"milliseconds_per_step\": " << ms << ", \"speedup\": " << first / ms << "}"
+                << (c + 1 < configurationCount || t + 1 < threads.size() ? ",\n" : "\n");
+      std::cout.flush();
+    }
+  }
+  std::cout << "  ]\n}" << std::endl;
+  return 0;
+}
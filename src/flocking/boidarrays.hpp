@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// allocator for vectors whose data must start on an Alignment byte boundary, for aligned SIMD loads
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+  using value_type = T;
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+  void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+};
+
+/**
+ * Boids stored as one array per coordinate (structure of arrays), in the order of a list of indices.
+ *
+ * Flocking fills it in spatial grid order every step, so the candidates of a grid row are a contiguous
+ * range and the force kernels load a 32 byte register of neighbors per instruction: 4 doubles or 8 floats.
+ * Arrays start on 32 byte boundaries and are padded to a multiple of Width, so a kernel may always load
+ * whole registers, the lanes past the end are masked out and never read as boids.
+ */
+template <typename T>
+struct BasicBoidArrays {
+  static constexpr size_t Width = 32 / sizeof(T);
+  using Array = std::vector<T, AlignedAllocator<T, 32>>;
+
+  Array x, y, vx, vy;
+  size_t count = 0;
+
+  // boids[order[0]], boids[order[1]], ... any container of objects with a Vector2 position and velocity
+  template <typename Agents>
+  void Gather(const Agents& boids, const std::vector<int>& order) {
+    count = order.size();
+    const size_t padded = (count + Width - 1) / Width * Width;
+    for (Array* array : {&x, &y, &vx, &vy}) array->assign(padded, T(0));
+    for (size_t k = 0; k < count; k++) {
+      const auto& boid = boids[order[k]];
+      x[k] = boid.position.x;
+      y[k] = boid.position.y;
+      vx[k] = boid.velocity.x;
+      vy[k] = boid.velocity.y;
+    }
+  }
+};
+
+using BoidArrays = BasicBoidArrays<double>;
@@ -0,0 +1,231 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// a whole file mapped read only. an empty file maps to nothing, with size 0
+struct MappedFile {
+  const unsigned char* data = nullptr;
+  size_t size = 0;
+
+  explicit MappedFile(const std::string& path) { Map(path); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Unmap(); }
+
+private:
+#if defined(_WIN32)
+  HANDLE mapping = nullptr;
+
+  void Map(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot open " + path);
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+      CloseHandle(file);
+      throw std::runtime_error("cannot map " + path);
+    }
+    if (fileSize.QuadPart == 0) {
+      CloseHandle(file);
+      return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) throw std::runtime_error("cannot map " + path);
+    data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+      CloseHandle(mapping);
+      mapping = nullptr;
+      throw std::runtime_error("cannot map " + path);
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+  }
+
+  void Unmap() {
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    data = nullptr;
+    mapping = nullptr;
+    size = 0;
+  }
+#else
+  void Map(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw std::runtime_error("cannot map " + path);
+    }
+    if (info.st_size == 0) {
+      ::close(fd);
+      return;
+    }
+    void* address = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (address == MAP_FAILED) throw std::runtime_error("cannot map " + path);
+    data = static_cast<const unsigned char*>(address);
+    size = static_cast<size_t>(info.st_size);
+  }
+
+  void Unmap() {
+    if (data) ::munmap(const_cast<unsigned char*>(data), size);
+    data = nullptr;
+    size = 0;
+  }
+#endif
+};
+
+/**
+ * Binary snapshot of a flock, to resume a run after a crash without parsing the simulator text input again.
+ *
+ * Layout, all little endian:
+ *   0  char[4]     magic "FLCK"
+ *   4  uint16      version (1)
+ *   6  uint16      bytes per scalar, 4 for a float flock and 8 for a double one
+ *   8  uint32      flags, 1 when boid ids follow the boids
+ *  12  uint32      0
+ *  16  uint64      boids
+ *  24  int64       steps done
+ *  32  float64[7]  parameters, in the order of the simulator input header
+ *  88  uint64      0
+ *  96  x, y, vx, vy per boid, as scalars
+ *      with flag 1, the input index of every boid as uint32 (boids are stored as Flocking::Reorder left them)
+ *
+ * Only the current state is stored: Step overwrites the other buffer whole before reading it. Read() maps the
+ * file, checks its size against the header and copies the boids straight out of the mapping, so a restore
+ * costs about one pass over the file.
+ */
+struct Checkpoint {
+  static constexpr char Magic[4] = {'F', 'L', 'C', 'K'};
+  static constexpr uint16_t Version = 1;
+  static constexpr size_t HeaderSize = 96;
+  static constexpr uint32_t HasIds = 1;
+  // bytes encoded before handing them to the stream
+  static constexpr size_t BufferSize = 1 << 20;
+
+  // parameters has the fields of FlockingParameters, boids is a vector of boids, ids is empty or one per boid
+  template <typename Parameters, typename Agents>
+  static void Write(std::ostream& out, const Parameters& parameters, long long steps, const Agents& boids, const std::vector<int>& ids) {
+    using T = typename Agents::value_type::Scalar;
+    unsigned char header[HeaderSize] = {};
+    std::memcpy(header, Magic, sizeof(Magic));
+    Store(header + 4, Version);
+    Store(header + 6, (uint16_t)sizeof(T));
+    Store(header + 8, ids.empty() ? uint32_t(0) : HasIds);
+    Store(header + 16, (uint64_t)boids.size());
+    Store(header + 24, (int64_t)steps);
+    const double values[7] = {parameters.cohesionRadius, parameters.separationRadius, parameters.separationMaxForce, parameters.alignmentRadius,
+                              parameters.cohesionK,      parameters.separationK,      parameters.alignmentK};
+    for (int p = 0; p < 7; p++) Store(header + 32 + 8 * p, values[p]);
+    out.write((const char*)header, HeaderSize);
+
+    std::vector<unsigned char> buffer;
+    buffer.reserve(BufferSize + 4 * sizeof(T));
+    auto append = [&](auto value) {
+      buffer.resize(buffer.size() + sizeof(value));
+      Store(buffer.data() + buffer.size() - sizeof(value), value);
+      if (buffer.size() >= BufferSize) {
+        out.write((const char*)buffer.data(), (std::streamsize)buffer.size());
+        buffer.clear();
+      }
+    };
+    for (const auto& boid : boids) {
+      append((T)boid.position.x);
+      append((T)boid.position.y);
+      append((T)boid.velocity.x);
+      append((T)boid.velocity.y);
+    }
+    for (int id : ids) append((uint32_t)id);
+    out.write((const char*)buffer.data(), (std::streamsize)buffer.size());
+    out.flush();
+    if (!out) throw std::runtime_error("cannot write checkpoint");
+  }
+
+  // the counterpart of Write. the scalar type of boids must be the one the checkpoint was written with
+  template <typename Parameters, typename Agents>
+  static void Read(const std::string& path, Parameters& parameters, long long& steps, Agents& boids, std::vector<int>& ids) {
+    using T = typename Agents::value_type::Scalar;
+    const MappedFile file(path);
+    const unsigned char* data = file.data;
+    if (file.size < HeaderSize || std::memcmp(data, Magic, sizeof(Magic)) != 0) throw std::runtime_error("not a flock checkpoint: " + path);
+    if (Load<uint16_t>(data + 4) != Version) throw std::runtime_error("unsupported checkpoint version");
+    if (Load<uint16_t>(data + 6) != sizeof(T)) throw std::runtime_error("checkpoint scalar type does not match the flock");
+    const bool hasIds = (Load<uint32_t>(data + 8) & HasIds) != 0;
+    const uint64_t count = Load<uint64_t>(data + 16);
+    // the count is checked against the file size before anything is allocated for it
+    const size_t boidBytes = 4 * sizeof(T) + (hasIds ? 4 : 0);
+    if (count > (file.size - HeaderSize) / boidBytes || file.size != HeaderSize + count * boidBytes) throw std::runtime_error("truncated checkpoint: " + path);
+
+    steps = Load<int64_t>(data + 24);
+    double values[7];
+    for (int p = 0; p < 7; p++) values[p] = Load<double>(data + 32 + 8 * p);
+    parameters.cohesionRadius = values[0];
+    parameters.separationRadius = values[1];
+    parameters.separationMaxForce = values[2];
+    parameters.alignmentRadius = values[3];
+    parameters.cohesionK = values[4];
+    parameters.separationK = values[5];
+    parameters.alignmentK = values[6];
+
+    boids.clear();
+    boids.reserve(count);
+    const unsigned char* from = data + HeaderSize;
+    for (uint64_t i = 0; i < count; i++, from += 4 * sizeof(T)) {
+      auto& boid = boids.emplace_back();
+      boid.position.x = Load<T>(from);
+      boid.position.y = Load<T>(from + sizeof(T));
+      boid.velocity.x = Load<T>(from + 2 * sizeof(T));
+      boid.velocity.y = Load<T>(from + 3 * sizeof(T));
+    }
+
+    ids.clear();
+    if (!hasIds) return;
+    ids.resize(count);
+    // every input index exactly once, or the flock would lose boids when put back in input order
+    std::vector<bool> seen(count);
+    for (auto& id : ids) {
+      const uint32_t value = Load<uint32_t>(from);
+      from += 4;
+      if (value >= count || seen[value]) throw std::runtime_error("corrupt checkpoint ids: " + path);
+      seen[value] = true;
+      id = (int)value;
+    }
+  }
+
+private:
+  // memcpy compiles to a plain load or store, a byte swap only on big endian hosts
+  template <typename V>
+  static void Store(unsigned char* to, V value) {
+    std::memcpy(to, &value, sizeof(V));
+    if constexpr (std::endian::native == std::endian::big) std::reverse(to, to + sizeof(V));
+  }
+
+  template <typename V>
+  static V Load(const unsigned char* from) {
+    unsigned char bytes[sizeof(V)];
+    std::memcpy(bytes, from, sizeof(V));
+    if constexpr (std::endian::native == std::endian::big) std::reverse(bytes, bytes + sizeof(V));
+    V value;
+    std::memcpy(&value, bytes, sizeof(V));
+    return value;
+  }
+};
@@ -1,21 +1,81 @@
 // do not use AI.
+#pragma once
 #include "vector2.hpp"
+#include "spatialgrid.hpp"
+#include "quadtree.hpp"
+#include "verletlists.hpp"
+#include "morton.hpp"
+#include "boidarrays.hpp"
+#include "workstealing.hpp"
+#include "framewriter.hpp"
+#include "checkpoint.hpp"
+#include "lanes.hpp"
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <concepts>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <iomanip>
-
-struct Boid {
-  Boid(const Vector2& pos, const Vector2& vel): position(pos), velocity(vel){};
-  Boid():position({0,0}), velocity({0,0}){};
-  double weight = 1.0; // all boids weights 1 for simplicity, you can discard this in your math
-  Vector2 position;
-  Vector2 velocity;
+#include <istream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Everything below is templated on the scalar type T of positions and velocities. Boid, Cohesion, Alignment,
+ * Separation, Flocking and Simulator are the double versions; float halves the memory traffic and doubles
+ * the SIMD width. A float flock follows the double one within float rounding: forces of the same state agree
+ * to 1e-3 for k and maxForce of order 1, the worst cases being boids close to the center of their neighbors,
+ * where the cohesion direction is ill conditioned. Simulated values match the double ones to 1e-3 or 1e-6 of
+ * their magnitude, whichever is larger, on the test fixtures. Boids whose distance is within rounding of a
+ * radius may count as neighbors in one and not the other.
+ */
+template <typename T>
+struct BasicBoid {
+  using Scalar = T;
+  BasicBoid(const BasicVector2<T>& pos, const BasicVector2<T>& vel): position(pos), velocity(vel){};
+  BasicBoid():position({0,0}), velocity({0,0}){};
+  T weight = 1.0; // all boids weights 1 for simplicity, you can discard this in your math
+  BasicVector2<T> position;
+  BasicVector2<T> velocity;
+};
+
+using Boid = BasicBoid<double>;
+
+// the neighbor candidates of a boid: every boid, as the force descriptions below specify
+template <typename Agents>
+struct AllBoids {
+  const Agents& boids;
+  template <typename Visit>
+  void operator()(Visit&& visit) const {
+    for (int i = 0; i < (int)boids.size(); i++) visit(i);
+  }
 };
 
-struct Cohesion {
-  double radius;
-  double k;
+// or only the boids in the grid cells around it. same forces as long as the cells are at least as wide as the radius
+template <typename Position>
+struct GridCandidates {
+  const SpatialGrid& grid;
+  const Position& position;
+  template <typename Visit>
+  void operator()(Visit&& visit) const {
+    grid.ForEachCandidate(position, visit);
+  }
+};
+
+template <typename T>
+struct BasicCohesion {
+  using Vector = BasicVector2<T>;
+  using Agent = BasicBoid<T>;
+  using Agents = std::vector<Agent>;
 
-  Cohesion(double radius, double k): radius(radius), k(k){};
+  T radius;
+  T k;
+
+  BasicCohesion(): BasicCohesion(0, 0){};
+  BasicCohesion(T radius, T k): radius(radius), k(k){};
 
   /**
    * Computes the cohesion force for a given boid.
@@ -34,17 +94,55 @@ struct Cohesion {
    * @param boidAgentIndex The index of the boid for which to compute the cohesion force
    * @return Vector2 The cohesion force to be applied to the boid
    */
-  Vector2 ComputeForce(const std::vector<Boid>& boids, int boidAgentIndex) {
-    // TODO: Implement cohesion force calculation
-    return {0, 0};
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex) {
+    return ComputeForce(boids, boidAgentIndex, AllBoids<Agents>{boids});
+  }
+
+  // same force, only looking at the boids in the grid cells around the boid
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex, const SpatialGrid& grid) {
+    return ComputeForce(boids, boidAgentIndex, GridCandidates<Vector>{grid, boids[boidAgentIndex].position});
+  }
+
+  template <typename Candidates>
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex, const Candidates& candidates) {
+    const Vector& position = boids[boidAgentIndex].position;
+    Accumulator sum;
+    candidates([&](int i) { Accumulate(sum, position, boids[i], i == boidAgentIndex, position.DistanceSquared(boids[i].position)); });
+    return Force(sum, position);
+  }
+
+  // the force is built in two halves, so the fused kernel in Flocking can feed every force from one neighbor scan
+  struct Accumulator {
+    Vector centerOfMass;
+    int count = 0;
+  };
+
+  void Accumulate(Accumulator& sum, const Vector&, const Agent& other, bool self, T distanceSquared) const {
+    if (!self && distanceSquared <= radius * radius) {
+      sum.centerOfMass += other.position;
+      sum.count++;
+    }
+  }
+
+  Vector Force(const Accumulator& sum, const Vector& position) const {
+    if (sum.count == 0) return {0, 0};
+    return (sum.centerOfMass / sum.count - position).normalized() * k;
   }
 };
 
-struct Alignment {
-  double radius;
-  double k;
+using Cohesion = BasicCohesion<double>;
+
+template <typename T>
+struct BasicAlignment {
+  using Vector = BasicVector2<T>;
+  using Agent = BasicBoid<T>;
+  using Agents = std::vector<Agent>;
 
-  Alignment(double radius, double k): radius(radius), k(k){};
+  T radius;
+  T k;
+
+  BasicAlignment(): BasicAlignment(0, 0){};
+  BasicAlignment(T radius, T k): radius(radius), k(k){};
 
   /**
    * Computes the alignment force for a given boid.
@@ -66,19 +164,56 @@ struct Alignment {
    * @param boidAgentIndex The index of the boid for which to compute the alignment force
    * @return Vector2 The alignment force to be applied to the boid
    */
-  Vector2 ComputeForce(const std::vector<Boid>& boids, int boidAgentIndex) {
-    // TODO: Implement alignment force calculation
-    return {0, 0};
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex) {
+    return ComputeForce(boids, boidAgentIndex, AllBoids<Agents>{boids});
+  }
+
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex, const SpatialGrid& grid) {
+    return ComputeForce(boids, boidAgentIndex, GridCandidates<Vector>{grid, boids[boidAgentIndex].position});
+  }
+
+  template <typename Candidates>
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex, const Candidates& candidates) {
+    const Vector& position = boids[boidAgentIndex].position;
+    Accumulator sum;
+    candidates([&](int i) { Accumulate(sum, position, boids[i], i == boidAgentIndex, position.DistanceSquared(boids[i].position)); });
+    return Force(sum, position);
+  }
+
+  struct Accumulator {
+    Vector velocity;
+    int count = 0;
+  };
+
+  // the boid itself counts too
+  void Accumulate(Accumulator& sum, const Vector&, const Agent& other, bool, T distanceSquared) const {
+    if (distanceSquared <= radius * radius) {
+      sum.velocity += other.velocity;
+      sum.count++;
+    }
+  }
+
+  Vector Force(const Accumulator& sum, const Vector&) const {
+    if (sum.count == 0) return {0, 0};
+    return sum.velocity / sum.count * k;
   }
 };
 
-struct Separation {
-  double radius;
-  double k;
+using Alignment = BasicAlignment<double>;
+
+template <typename T>
+struct BasicSeparation {
+  using Vector = BasicVector2<T>;
+  using Agent = BasicBoid<T>;
+  using Agents = std::vector<Agent>;
+
+  T radius;
+  T k;
   // if the computed force is greater than maxForce, we clip it to maxForce
-  double maxForce;
+  T maxForce;
 
-  Separation(double radius, double k, double maxForce): radius(radius), k(k), maxForce(maxForce){};
+  BasicSeparation(): BasicSeparation(0, 0, 0){};
+  BasicSeparation(T radius, T k, T maxForce): radius(radius), k(k), maxForce(maxForce){};
 
   /**
    * Computes the separation force for a given boid.
@@ -104,26 +239,191 @@ struct Separation {
    * @param boidAgentIndex The index of the boid for which to compute the separation force
    * @return Vector2 The separation force to be applied to the boid (clamped to maxForce)
    */
-  Vector2 ComputeForce(const std::vector<Boid>& boids, int boidAgentIndex) {
-    // TODO: Implement separation force calculation
-    return {0, 0};
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex) {
+    return ComputeForce(boids, boidAgentIndex, AllBoids<Agents>{boids});
+  }
+
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex, const SpatialGrid& grid) {
+    return ComputeForce(boids, boidAgentIndex, GridCandidates<Vector>{grid, boids[boidAgentIndex].position});
+  }
+
+  template <typename Candidates>
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex, const Candidates& candidates) {
+    const Vector& position = boids[boidAgentIndex].position;
+    Accumulator sum;
+    candidates([&](int i) { Accumulate(sum, position, boids[i], i == boidAgentIndex, position.DistanceSquared(boids[i].position)); });
+    return Force(sum, position);
+  }
+
+  struct Accumulator {
+    Vector force;
+  };
+
+  void Accumulate(Accumulator& sum, const Vector& position, const Agent& other, bool self, T distanceSquared) const {
+    // boids on top of each other have no direction to push away from
+    if (!self && distanceSquared <= radius * radius && distanceSquared > MinDistanceSquared) {
+      T distance = std::sqrt(distanceSquared);
+      sum.force += (position - other.position) / distance * (k / distance);
+    }
+  }
+
+  Vector Force(const Accumulator& sum, const Vector&) const { return Clamp(sum.force); }
+
+  static constexpr T MinDistanceSquared = T(1e-12);
+
+  // scales the force down to maxForce, keeping its direction
+  Vector Clamp(const Vector& force) const {
+    T magnitude = force.getMagnitude();
+    if (magnitude > maxForce) return force * (maxForce / magnitude);
+    return force;
+  }
+};
+
+using Separation = BasicSeparation<double>;
+
+/**
+ * What SteeringFlocking needs from a steering behavior, the interface Cohesion, Alignment and Separation share:
+ * a radius, an Accumulator fed with every boid within the largest radius of the flock, and the Force computed
+ * from it. Accumulate gets the boid position, the other boid, whether it is the boid itself and their squared
+ * distance, and applies its own radius. A behavior that ignores the neighbors, such as steering to a goal, can
+ * have radius 0 and an empty Accumulator.
+ */
+template <typename Behavior, typename T>
+concept SteeringBehavior = requires(const Behavior behavior, typename Behavior::Accumulator sum, const BasicVector2<T> position, const BasicBoid<T> other, T distanceSquared) {
+  { behavior.radius } -> std::convertible_to<T>;
+  behavior.Accumulate(sum, position, other, true, distanceSquared);
+  { behavior.Force(sum, position) } -> std::convertible_to<BasicVector2<T>>;
+};
+
+// the parameters of a flock, in the order of the simulator input header
+struct FlockingParameters {
+  double cohesionRadius = 0, separationRadius = 0, separationMaxForce = 0, alignmentRadius = 0;
+  double cohesionK = 0, separationK = 0, alignmentK = 0;
+
+  friend std::istream& operator>>(std::istream& in, FlockingParameters& parameters) {
+    return in >> parameters.cohesionRadius >> parameters.separationRadius >> parameters.separationMaxForce >> parameters.alignmentRadius >>
+           parameters.cohesionK >> parameters.separationK >> parameters.alignmentK;
   }
 };
 
-struct Flocking {
+/**
+ * A flock steered by any number of behaviors, whose forces add up. The neighbor loop is written once for the
+ * whole pack: every candidate within the largest radius is fed to every accumulator in turn, all inlined, so
+ * adding a behavior costs its own accumulate and no extra scan. BasicFlocking<T> is the instantiation with
+ * cohesion, alignment and separation, the flock of the simulator input, and the only one with the parameter
+ * constructors and the StructOfArrays kernel.
+ */
+template <typename T, SteeringBehavior<T>... Behaviors>
+struct SteeringFlocking {
+  static_assert(sizeof...(Behaviors) > 0, "a flock needs at least one steering behavior");
+
+  using Vector = BasicVector2<T>;
+  using Agent = BasicBoid<T>;
+  using Agents = std::vector<Agent>;
+
+  // cohesion, alignment and separation, in that order
+  static constexpr bool Standard = std::is_same_v<std::tuple<Behaviors...>, std::tuple<BasicCohesion<T>, BasicAlignment<T>, BasicSeparation<T>>>;
+
 private:
-  Cohesion cohesion;
-  Alignment alignment;
-  Separation separation;
+  std::tuple<Behaviors...> behaviors;
+  using Accumulators = std::tuple<typename Behaviors::Accumulator...>;
 
   // double buffering. to generate a new state, we only use the data from the current state. when the new state is generated, swap them and repeat next frame
-  std::vector<Boid> currentState, newState;
+  Agents currentState, newState;
+  // neighbor index rebuilt at the start of every step for the largest radius, the one picked by neighborIndex
+  SpatialGrid grid;
+  LinearQuadtree quadtree;
+  // lists kept across steps when neighborIndex is VerletLists, built on the grid. the boids of a list within
+  // the largest radius, per boid, summed into the hit counter after every step
+  VerletLists verlet;
+  std::vector<int> verletHits;
+  // the current state in index order, used when storage is StructOfArrays
+  BasicBoidArrays<T> sorted;
+  // threads computing the forces, none when stepping on the calling thread only. shared by copies
+  std::shared_ptr<WorkStealingPool> pool;
+
+  // once reordered, the boid in slot k of the state buffers is boid ids[k] of the input. empty until then
+  std::vector<int> ids, idBuffer;
+  MortonOrder morton;
+  // GetCurrentState() in input order, when the buffers are not
+  Agents inputOrder;
+  long long stepCount = 0;
 
 public:
+  /**
+   * How Step reads the flock while computing forces.
+   *
+   * ArrayOfStructs walks the boids in place. StructOfArrays first copies positions and velocities into
+   * separate arrays sorted by grid cell, then runs a kernel that handles a register of neighbors per iteration,
+   * 4 doubles or 8 floats with AVX2 when the build enables it. The boids themselves always live in a vector of
+   * boids, so GetCurrentState() works the same in both modes. Results agree within rounding: the SIMD kernel
+   * sums in a different order. The kernel is written for the standard behaviors, other flocks always walk
+   * the boids in place.
+   */
+  enum class Storage { ArrayOfStructs, StructOfArrays };
+  Storage storage = Storage::ArrayOfStructs;
+
+  /**
+   * How Step finds the neighbor candidates of a boid.
+   *
+   * UniformGrid costs little to build, but a cell holds every boid that lands in it, so a flock packed in a few
+   * cells scans most of itself. Quadtree splits dense areas down to GetQuadtree().leafCapacity boids per leaf
+   * and skips leaves out of reach, which keeps queries short in clusters at the price of a radix sort per step.
+   * VerletLists keeps per boid lists of the boids within the radius plus GetVerletLists().skin, and only
+   * rebuilds them, on the grid, once a boid has moved more than half the skin. The lists are scattered
+   * indices, so forces are computed from the boids in place whatever the storage.
+   * All give the same forces up to summation order.
+   */
+  enum class NeighborIndex { UniformGrid, Quadtree, VerletLists };
+  NeighborIndex neighborIndex = NeighborIndex::UniformGrid;
+
+  /**
+   * Steps between two calls to Reorder() at the start of Step, 0 for never. Boids drift away from their
+   * neighbors in the state buffers as the flock moves, so the force loops, which visit boids by space, jump
+   * around memory more and more. Forces only change by summation order.
+   */
+  int reorderInterval = 0;
+
+  // boids per scheduled chunk, consecutive in grid order so a chunk covers a small area
+  static constexpr int ChunkSize = 256;
+
+  /**
+   * Number of threads used by Step, 0 for one per hardware thread. Every boid's new state only depends on
+   * the current state, so the result is the same for any thread count.
+   */
+  void SetThreads(int threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    pool = threads > 1 ? std::make_shared<WorkStealingPool>(threads) : nullptr;
+  }
+  int GetThreads() const { return pool ? pool->ThreadCount() : 1; }
+
   // default constructor
-  Flocking(): cohesion(0, 0), alignment(0, 0), separation(0, 0, 0){};
-  Flocking(double cohesionRadius, double separationRadius, double separationMaxForce, double alignmentRadius, double cohesionK, double separationK, double alignmentK, std::vector<Boid> boids): 
-  cohesion(cohesionRadius, cohesionK), alignment(alignmentRadius, alignmentK), separation(separationRadius, separationK, separationMaxForce), currentState(boids), newState(boids){};
+  SteeringFlocking(){};
+  SteeringFlocking(Agents boids, Behaviors... steering): behaviors(std::move(steering)...), currentState(boids), newState(boids){};
+  SteeringFlocking(T cohesionRadius, T separationRadius, T separationMaxForce, T alignmentRadius, T cohesionK, T separationK, T alignmentK, Agents boids) requires Standard:
+  SteeringFlocking(std::move(boids), BasicCohesion<T>(cohesionRadius, cohesionK), BasicAlignment<T>(alignmentRadius, alignmentK), BasicSeparation<T>(separationRadius, separationK, separationMaxForce)){};
+  SteeringFlocking(const FlockingParameters& p, Agents boids) requires Standard:
+  SteeringFlocking(p.cohesionRadius, p.separationRadius, p.separationMaxForce, p.alignmentRadius, p.cohesionK, p.separationK, p.alignmentK, std::move(boids)){};
+
+  FlockingParameters GetParameters() const requires Standard {
+    const auto& [cohesion, alignment, separation] = behaviors;
+    return {cohesion.radius, separation.radius, separation.maxForce, alignment.radius, cohesion.k, separation.k, alignment.k};
+  }
+
+  // the behaviors by position or type, to tune them between steps
+  template <size_t I>
+  auto& GetBehavior() {
+    return std::get<I>(behaviors);
+  }
+  template <typename Behavior>
+  Behavior& GetBehavior() {
+    return std::get<Behavior>(behaviors);
+  }
+
+  // the largest radius of the behaviors, the reach of the neighbor search
+  T MaxRadius() const {
+    return std::apply([](const auto&... behavior) { return std::max({T(behavior.radius)...}); }, behaviors);
+  }
 
   /**
    * Performs one simulation step for the flocking system.
@@ -155,58 +455,390 @@ public:
    * 
    * @param deltaTime The time step size for numerical integration (in simulation time units)
    */
-  void Step(double deltaTime) {
-    // TODO: Implement simulation step
-    // 1. Compute forces for each boid
-    // 2. Update velocities and positions using numerical integration
-    // 3. Swap state buffers
+  void Step(T deltaTime) {
+    if (reorderInterval > 0 && stepCount % reorderInterval == 0) Reorder();
+    const T radius = MaxRadius();
+    if (neighborIndex == NeighborIndex::Quadtree) {
+      quadtree.Build(currentState, radius);
+      Integrate(quadtree, deltaTime);
+    } else if (neighborIndex == NeighborIndex::VerletLists) {
+      IntegrateVerlet(radius, deltaTime);
+    } else {
+      grid.Build(currentState, radius);
+      Integrate(grid, deltaTime);
+    }
+    std::swap(currentState, newState);
+    stepCount++;
   }
 
-  std::vector<Boid>& GetCurrentState() {
-    return currentState;
+  /**
+   * Sorts the state buffers along the Z-order curve of the positions, so boids close in space are close in
+   * memory. Boids keep their input index for GetCurrentState(), which still returns them in input order.
+   */
+  void Reorder() {
+    morton.Build(currentState);
+    const int count = (int)currentState.size();
+    // newState is overwritten by the next step anyway, it holds the sorted copy
+    idBuffer.resize(count);
+    for (int k = 0; k < count; k++) {
+      const int from = morton.indices[k];
+      newState[k] = currentState[from];
+      idBuffer[k] = ids.empty() ? from : ids[from];
+    }
+    std::swap(currentState, newState);
+    ids.swap(idBuffer);
+    verlet.Invalidate();
+  }
+
+  long long GetStepCount() const { return stepCount; }
+
+  /**
+   * Saves the parameters, the state and the step count as a Checkpoint. A flock loaded from it steps on
+   * exactly as this one would. How it is stepped (storage, neighborIndex, reorderInterval, threads) is not
+   * saved; set it again after loading. Verlet lists are rebuilt on the first step, so with VerletLists
+   * forces only agree up to summation order.
+   */
+  void SaveCheckpoint(std::ostream& out) const requires Standard {
+    Checkpoint::Write(out, GetParameters(), stepCount, currentState, ids);
+  }
+
+  // through a temporary file renamed over path, so a crash while saving leaves the previous checkpoint whole
+  void SaveCheckpoint(const std::string& path) const requires Standard {
+    const std::string temporary = path + ".tmp";
+    {
+      std::ofstream out(temporary, std::ios::binary);
+      if (!out) throw std::runtime_error("cannot create " + temporary);
+      SaveCheckpoint(out);
+    }
+    std::filesystem::rename(temporary, path);
+  }
+
+  static SteeringFlocking LoadCheckpoint(const std::string& path) requires Standard {
+    FlockingParameters parameters;
+    long long steps;
+    Agents boids;
+    std::vector<int> order;
+    Checkpoint::Read(path, parameters, steps, boids, order);
+    SteeringFlocking flocking(parameters, {});
+    flocking.currentState = std::move(boids);
+    // scratch, every step writes it whole before reading it
+    flocking.newState.resize(flocking.currentState.size());
+    flocking.stepCount = steps;
+    flocking.ids = std::move(order);
+    return flocking;
+  }
+
+  /**
+   * Total force on a boid: the sum of the behavior forces, with one walk over the candidates of a neighbor
+   * index (SpatialGrid or LinearQuadtree) instead of one per behavior. Every candidate is tested once against
+   * the largest radius and then fed to every accumulator, which applies its own radius, so the result is the
+   * same as calling the ComputeForce of every behavior.
+   */
+  template <typename Index>
+  Vector ComputeForce(const Agents& boids, int boidAgentIndex, const Index& neighbors) const {
+    int inReach;
+    const Vector& position = boids[boidAgentIndex].position;
+    return FusedForce(boids, boidAgentIndex, [&](auto&& visit) { neighbors.ForEachCandidate(position, visit); }, inReach);
+  }
+
+  /**
+   * Same total force for the boid at position self of the arrays gathered in index order. The candidates of a
+   * grid row or a quadtree leaf are contiguous, so they are processed a register at a time: lanes outside the
+   * range, or the boid itself where a force excludes it, are masked out. Separation uses (p - o) * k / d^2,
+   * which is the specified k / d along the unit direction without a square root.
+   */
+  template <typename Index>
+  Vector ComputeForce(const BasicBoidArrays<T>& boids, int self, const Index& neighbors) const requires Standard {
+    const BasicCohesion<T>& cohesion = std::get<0>(behaviors);
+    const BasicAlignment<T>& alignment = std::get<1>(behaviors);
+    const BasicSeparation<T>& separation = std::get<2>(behaviors);
+    const T px = boids.x[self], py = boids.y[self];
+    const T cohesionRadiusSquared = cohesion.radius * cohesion.radius;
+    const T alignmentRadiusSquared = alignment.radius * alignment.radius;
+    const T separationRadiusSquared = separation.radius * separation.radius;
+    T cohesionX = 0, cohesionY = 0, cohesionCount = 0;
+    T alignmentX = 0, alignmentY = 0, alignmentCount = 0;
+    T separationX = 0, separationY = 0;
+
+#if defined(__AVX2__)
+    using L = Lanes<T>;
+    using Register = typename L::Register;
+    const Register positionX = L::Set(px), positionY = L::Set(py);
+    const Register cohesionR2 = L::Set(cohesionRadiusSquared), alignmentR2 = L::Set(alignmentRadiusSquared);
+    const Register separationR2 = L::Set(separationRadiusSquared), minimum = L::Set(BasicSeparation<T>::MinDistanceSquared);
+    const Register separationK = L::Set(separation.k), one = L::Set(1);
+    Register cx = L::Zero(), cy = L::Zero(), cn = L::Zero();
+    Register ax = L::Zero(), ay = L::Zero(), an = L::Zero();
+    Register sx = L::Zero(), sy = L::Zero();
+    neighbors.ForEachCandidateRange(Vector(px, py), [&](int begin, int end) {
+      // start on the aligned block holding begin, lanes before begin are masked like the ones past end
+      for (int j = begin & ~(L::Width - 1); j < end; j += L::Width) {
+        Register inRange, other;
+        L::IndexMasks(j, begin, end, self, inRange, other);
+
+        const Register ox = L::Load(&boids.x[j]), oy = L::Load(&boids.y[j]);
+        const Register dx = L::Sub(positionX, ox), dy = L::Sub(positionY, oy);
+        const Register d2 = L::Add(L::Mul(dx, dx), L::Mul(dy, dy));
+
+        const Register cohesionMask = L::And(other, L::LessEqual(d2, cohesionR2));
+        cx = L::Add(cx, L::And(cohesionMask, ox));
+        cy = L::Add(cy, L::And(cohesionMask, oy));
+        cn = L::Add(cn, L::And(cohesionMask, one));
+
+        const Register alignmentMask = L::And(inRange, L::LessEqual(d2, alignmentR2));
+        ax = L::Add(ax, L::And(alignmentMask, L::Load(&boids.vx[j])));
+        ay = L::Add(ay, L::And(alignmentMask, L::Load(&boids.vy[j])));
+        an = L::Add(an, L::And(alignmentMask, one));
+
+        // masked lanes may divide by zero, the and drops whatever they produce
+        const Register separationMask = L::And(L::And(other, L::LessEqual(d2, separationR2)), L::Greater(d2, minimum));
+        const Register weight = L::Div(separationK, d2);
+        sx = L::Add(sx, L::And(separationMask, L::Mul(dx, weight)));
+        sy = L::Add(sy, L::And(separationMask, L::Mul(dy, weight)));
+      }
+    });
+    cohesionX = L::Sum(cx);
+    cohesionY = L::Sum(cy);
+    cohesionCount = L::Sum(cn);
+    alignmentX = L::Sum(ax);
+    alignmentY = L::Sum(ay);
+    alignmentCount = L::Sum(an);
+    separationX = L::Sum(sx);
+    separationY = L::Sum(sy);
+#else
+    neighbors.ForEachCandidateRange(Vector(px, py), [&](int begin, int end) {
+      for (int j = begin; j < end; j++) {
+        const T dx = px - boids.x[j], dy = py - boids.y[j];
+        const T d2 = dx * dx + dy * dy;
+        if (j != self && d2 <= cohesionRadiusSquared) {
+          cohesionX += boids.x[j];
+          cohesionY += boids.y[j];
+          cohesionCount++;
+        }
+        if (d2 <= alignmentRadiusSquared) {
+          alignmentX += boids.vx[j];
+          alignmentY += boids.vy[j];
+          alignmentCount++;
+        }
+        if (j != self && d2 <= separationRadiusSquared && d2 > BasicSeparation<T>::MinDistanceSquared) {
+          separationX += dx * (separation.k / d2);
+          separationY += dy * (separation.k / d2);
+        }
+      }
+    });
+#endif
+
+    const Vector position(px, py);
+    return cohesion.Force({Vector(cohesionX, cohesionY), (int)cohesionCount}, position) +
+           alignment.Force({Vector(alignmentX, alignmentY), (int)alignmentCount}, position) +
+           separation.Force({Vector(separationX, separationY)}, position);
+  }
+
+  // the boids in input order. after a reorder this is a copy, changes to it do not reach the simulation
+  Agents& GetCurrentState() {
+    if (ids.empty()) return currentState;
+    inputOrder.resize(currentState.size());
+    for (size_t k = 0; k < currentState.size(); k++) inputOrder[ids[k]] = currentState[k];
+    return inputOrder;
+  }
+
+  // to tune leafCapacity
+  LinearQuadtree& GetQuadtree() {
+    return quadtree;
+  }
+
+  // to tune the skin and read the rebuild and hit rates
+  VerletLists& GetVerletLists() {
+    return verlet;
+  }
+
+private:
+  // the fused force over candidates(visit), which calls visit(index) for every candidate. inReach is set to
+  // the number of candidates within the largest radius
+  template <typename Candidates>
+  Vector FusedForce(const Agents& boids, int boidAgentIndex, const Candidates& candidates, int& inReach) const {
+    const Vector& position = boids[boidAgentIndex].position;
+    const T maxRadius = MaxRadius();
+    const T maxRadiusSquared = maxRadius * maxRadius;
+    Accumulators sums;
+    inReach = 0;
+    candidates([&](int i) {
+      const Agent& other = boids[i];
+      const T distanceSquared = position.DistanceSquared(other.position);
+      if (distanceSquared > maxRadiusSquared) return;
+      inReach++;
+      Accumulate(sums, position, other, i == boidAgentIndex, distanceSquared, std::index_sequence_for<Behaviors...>());
+    });
+    return Force(sums, position, std::index_sequence_for<Behaviors...>());
+  }
+
+  // one neighbor into every accumulator, expanded over the pack at compile time
+  template <size_t... I>
+  void Accumulate(Accumulators& sums, const Vector& position, const Agent& other, bool self, T distanceSquared, std::index_sequence<I...>) const {
+    (std::get<I>(behaviors).Accumulate(std::get<I>(sums), position, other, self, distanceSquared), ...);
+  }
+
+  // the forces summed in pack order
+  template <size_t... I>
+  Vector Force(const Accumulators& sums, const Vector& position, std::index_sequence<I...>) const {
+    return (... + std::get<I>(behaviors).Force(std::get<I>(sums), position));
+  }
+
+  // calls body(begin, end) over [0, count), on the pool if there is one
+  void Run(int count, const std::function<void(int, int)>& body) {
+    if (pool)
+      pool->ParallelFor(count, ChunkSize, body);
+    else
+      body(0, count);
+  }
+
+  // new states of every boid into newState, with the candidates of an index built on the current state
+  template <typename Index>
+  void Integrate(const Index& neighbors, T deltaTime) {
+    const bool arrays = Standard && storage == Storage::StructOfArrays;
+    if (arrays) sorted.Gather(currentState, neighbors.indices);
+    Run((int)currentState.size(), [&](int begin, int end) {
+      for (int k = begin; k < end; k++) {
+        // in index order, so consecutive boids share most of their neighbors in cache
+        const int i = neighbors.indices[k];
+        Vector force;
+        if constexpr (Standard) force = arrays ? ComputeForce(sorted, k, neighbors) : ComputeForce(currentState, i, neighbors);
+        else force = ComputeForce(currentState, i, neighbors);
+        Advance(i, force, deltaTime);
+      }
+    });
+  }
+
+  // same with the Verlet lists, rebuilt first if a boid moved too far since they were built
+  void IntegrateVerlet(T radius, T deltaTime) {
+    const int count = (int)currentState.size();
+    if (verlet.NeedsRebuild(currentState, radius)) {
+      verlet.Build(currentState, radius, grid, [this](int n, const std::function<void(int, int)>& body) { Run(n, body); });
+    }
+    verletHits.resize(count);
+    // the grid is only rebuilt with the lists, its order still groups boids that were close then
+    Run(count, [&](int begin, int end) {
+      for (int k = begin; k < end; k++) {
+        const int i = grid.indices[k];
+        Vector force = FusedForce(currentState, i, [&](auto&& visit) { verlet.ForEachCandidate(i, visit); }, verletHits[i]);
+        Advance(i, force, deltaTime);
+      }
+    });
+    verlet.steps++;
+    verlet.candidates += (long long)verlet.neighbors.size();
+    for (int hits : verletHits) verlet.hits += hits;
+  }
+
+  void Advance(int i, const Vector& force, T deltaTime) {
+    Agent& boid = newState[i];
+    boid.velocity = currentState[i].velocity + force * deltaTime;
+    boid.position = currentState[i].position + boid.velocity * deltaTime;
   }
 };
 
-struct Simulator {
+template <typename T>
+using BasicFlocking = SteeringFlocking<T, BasicCohesion<T>, BasicAlignment<T>, BasicSeparation<T>>;
+
+using Flocking = BasicFlocking<double>;
+
+template <typename T>
+struct BasicSimulator {
+  using Agents = std::vector<BasicBoid<T>>;
+
 private:
-  Flocking flocking;
+  BasicFlocking<T> flocking;
   
   // stream can be a file or cin
   std::istream& stream;
-  std::vector<std::vector<Boid>> states;
+  // every frame computed, only kept with keepHistory: it grows by a copy of the flock per step
+  bool keepHistory;
+  std::vector<Agents> states;
+  // see SetCheckpoints
+  std::string checkpointPath;
+  int checkpointEvery = 0;
+
+  void SaveCheckpointIfDue() {
+    if (checkpointEvery > 0 && flocking.GetStepCount() % checkpointEvery == 0) flocking.SaveCheckpoint(checkpointPath);
+  }
   
 public:
-  Simulator(std::istream& stream): stream(stream) {
-    double cohesionRadius, separationRadius, separationMaxForce, alignmentRadius, cohesionK, separationK, alignmentK;
-    int numberOfBoids;
-    stream >> cohesionRadius >> separationRadius >> separationMaxForce >> alignmentRadius >> cohesionK >> separationK >> alignmentK >> numberOfBoids;
-    std::vector<Boid> boids;
-    for (int i = 0; i < numberOfBoids; i++) {
-      Boid b;
+  // reads the parameters and the flock from stream. without keepHistory no frame is kept, so OutputStates
+  // throws: write frames while running with Run(out) instead
+  BasicSimulator(std::istream& stream, bool keepHistory = false): stream(stream), keepHistory(keepHistory) {
+    FlockingParameters parameters;
+    int numberOfBoids = 0;
+    stream >> parameters >> numberOfBoids;
+    Agents boids;
+    // a malformed input stops at the first value that fails, leaving stream failed for the caller to check
+    for (int i = 0; i < numberOfBoids && stream; i++) {
+      BasicBoid<T> b;
       stream >> b.position.x >> b.position.y >> b.velocity.x >> b.velocity.y;
       boids.push_back(b);
     }
-    flocking = Flocking(cohesionRadius, separationRadius, separationMaxForce, alignmentRadius, cohesionK, separationK, alignmentK, boids);
+    flocking = BasicFlocking<T>(parameters, boids);
   }
 
+  // resumes from a checkpoint saved by Flocking::SaveCheckpoint, so stream only holds the time steps left
+  BasicSimulator(const std::string& checkpoint, std::istream& stream, bool keepHistory = false):
+  flocking(BasicFlocking<T>::LoadCheckpoint(checkpoint)), stream(stream), keepHistory(keepHistory) {}
+
+  /**
+   * Makes Run save a checkpoint to path whenever the step count reaches a multiple of every, each one
+   * replacing the last. 0 turns it off.
+   */
+  void SetCheckpoints(const std::string& path, int every) {
+    checkpointPath = path;
+    checkpointEvery = every;
+  }
+
+  // runs every step of the input, keeping the frames if keepHistory is set
   void Run() {
     double deltaTime;
     while (stream >> deltaTime) {
       flocking.Step(deltaTime);
-      states.push_back(flocking.GetCurrentState());
+      if (keepHistory) states.push_back(flocking.GetCurrentState());
+      SaveCheckpointIfDue();
     }
   }
 
-  std::vector<std::vector<Boid>> GetStates() {
-    return states;
+  /**
+   * Runs every step of the input and writes frames to out as soon as they are computed, so memory stays
+   * proportional to the flock whatever the number of steps. With every = N only frames N, 2N, 3N... are
+   * written, counting from 1. Frames count the steps of the flock, so a run resumed from a checkpoint
+   * writes the frames the uninterrupted run would have. Frames are still kept if keepHistory is set.
+   */
+  void Run(std::ostream& out, int every = 1, FrameFormat format = FrameFormat::Text) {
+    FrameWriter writer(out, format);
+    Run(writer, every);
   }
 
-  void OutputStates(std::ostream& out) const {
-    out << std::fixed << std::setprecision(3);
-    for (const auto& state : states) {
-      for (auto boid : state) {
-        out << boid.position.x << " " << boid.position.y << " " << boid.velocity.x << " " << boid.velocity.y << std::endl;
-      }
+  void Run(FrameWriter& writer, int every = 1) {
+    every = std::max(every, 1);
+    double deltaTime;
+    while (stream >> deltaTime) {
+      flocking.Step(deltaTime);
+      if (flocking.GetStepCount() % every == 0) writer.Write(flocking.GetCurrentState());
+      if (keepHistory) states.push_back(flocking.GetCurrentState());
+      SaveCheckpointIfDue();
     }
+    writer.Flush();
   }
-};
\ No newline at end of file
+
+  // to pick the storage mode or the thread count before running
+  BasicFlocking<T>& GetFlocking() {
+    return flocking;
+  }
+
+  const std::vector<Agents>& GetStates() const {
+    return states;
+  }
+
+  // writes the frames kept by a run. throws std::logic_error if the simulator was not built with keepHistory
+  void OutputStates(std::ostream& out, FrameFormat format = FrameFormat::Text) const {
+    if (!keepHistory) throw std::logic_error("OutputStates needs a simulator built with keepHistory");
+    FrameWriter writer(out, format);
+    for (const auto& state : states) writer.Write(state);
+  }
+};
+
+using Simulator = BasicSimulator<double>;
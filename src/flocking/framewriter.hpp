@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * How frames are written.
+ *
+ * Text is the simulator output format: one line per boid with position and velocity, 3 decimals.
+ *
+ * Float32 and Int16 are little endian binary, for tools that do not need text. A stream starts with a 16 byte
+ * header: "BOID", uint16 version (1), uint16 format (1 = Float32, 2 = Int16), uint32 boids per frame, uint32 0.
+ * Every Float32 frame is then x, y, vx, vy as float32 per boid. An Int16 frame starts with four float32, the
+ * center of the positions, the position step and the velocity step, followed by x, y, vx, vy as int16 per boid:
+ * a value is center + q * step for positions and q * step for velocities, so the error is at most half a step
+ * and the step is the largest magnitude of the frame over 32767.
+ */
+enum class FrameFormat : uint16_t { Text = 0, Float32 = 1, Int16 = 2 };
+
+struct FrameWriter {
+  static constexpr char Magic[4] = {'B', 'O', 'I', 'D'};
+  static constexpr uint16_t Version = 1;
+  static constexpr size_t HeaderSize = 16;
+  // bytes formatted before handing them to the stream
+  static constexpr size_t BufferSize = 1 << 20;
+
+  FrameWriter(std::ostream& out, FrameFormat format = FrameFormat::Text): out(out), format(format) { buffer.reserve(BufferSize + 256); }
+  FrameWriter(const FrameWriter&) = delete;
+  FrameWriter& operator=(const FrameWriter&) = delete;
+  ~FrameWriter() { Flush(); }
+
+  // agents is any container of objects with a position and a velocity
+  template <typename Agents>
+  void Write(const Agents& boids) {
+    if (format == FrameFormat::Text) {
+      for (const auto& boid : boids) {
+        AppendFixed(boid.position.x, ' ');
+        AppendFixed(boid.position.y, ' ');
+        AppendFixed(boid.velocity.x, ' ');
+        AppendFixed(boid.velocity.y, '\n');
+        if (buffer.size() >= BufferSize) Flush();
+      }
+      return;
+    }
+
+    if (!headerWritten) {
+      AppendBytes(Magic, 4);
+      AppendLittleEndian(Version, 2);
+      AppendLittleEndian((uint16_t)format, 2);
+      AppendLittleEndian((uint32_t)boids.size(), 4);
+      AppendLittleEndian(0, 4);
+      headerWritten = true;
+      boidsPerFrame = boids.size();
+    }
+    if (boids.size() != boidsPerFrame) throw std::invalid_argument("FrameWriter: binary frames must all have the same number of boids");
+
+    if (format == FrameFormat::Float32) {
+      for (const auto& boid : boids) {
+        for (double value : {boid.position.x, boid.position.y, boid.velocity.x, boid.velocity.y}) AppendFloat((float)value);
+        if (buffer.size() >= BufferSize) Flush();
+      }
+    } else {
+      double minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY, maxSpeed = 0;
+      for (const auto& boid : boids) {
+        minX = std::min(minX, (double)boid.position.x);
+        maxX = std::max(maxX, (double)boid.position.x);
+        minY = std::min(minY, (double)boid.position.y);
+        maxY = std::max(maxY, (double)boid.position.y);
+        maxSpeed = std::max({maxSpeed, std::abs((double)boid.velocity.x), std::abs((double)boid.velocity.y)});
+      }
+      // the steps are stored as float32, so quantize with exactly the values a reader sees
+      const float centerX = boids.empty() ? 0.0f : (float)((minX + maxX) / 2), centerY = boids.empty() ? 0.0f : (float)((minY + maxY) / 2);
+      const double extent = boids.empty() ? 0.0 : std::max({maxX - centerX, centerX - minX, maxY - centerY, centerY - minY});
+      const float positionStep = Step(extent), velocityStep = Step(maxSpeed);
+      AppendFloat(centerX);
+      AppendFloat(centerY);
+      AppendFloat(positionStep);
+      AppendFloat(velocityStep);
+      for (const auto& boid : boids) {
+        AppendLittleEndian((uint16_t)Quantize(boid.position.x - centerX, positionStep), 2);
+        AppendLittleEndian((uint16_t)Quantize(boid.position.y - centerY, positionStep), 2);
+        AppendLittleEndian((uint16_t)Quantize(boid.velocity.x, velocityStep), 2);
+        AppendLittleEndian((uint16_t)Quantize(boid.velocity.y, velocityStep), 2);
+        if (buffer.size() >= BufferSize) Flush();
+      }
+    }
+  }
+
+  void Flush() {
+    if (!buffer.empty()) out.write(buffer.data(), (std::streamsize)buffer.size());
+    buffer.clear();
+    out.flush();
+  }
+
+  /**
+   * Reads back a binary stream written by FrameWriter, as x, y, vx, vy per boid. Every element of the result
+   * is one frame. Int16 frames come back dequantized.
+   */
+  template <typename Boids>
+  static std::vector<Boids> ReadBinary(std::istream& in) {
+    unsigned char header[HeaderSize];
+    if (!in.read((char*)header, HeaderSize) || std::memcmp(header, Magic, 4) != 0) throw std::runtime_error("not a binary frame stream");
+    if (LoadLittleEndian(header + 4, 2) != Version) throw std::runtime_error("unsupported frame stream version");
+    const auto format = (FrameFormat)LoadLittleEndian(header + 6, 2);
+    if (format != FrameFormat::Float32 && format != FrameFormat::Int16) throw std::runtime_error("unknown frame format");
+    const size_t boids = LoadLittleEndian(header + 8, 4);
+
+    std::vector<Boids> frames;
+    const size_t frameBytes = format == FrameFormat::Float32 ? boids * 16 : 16 + boids * 8;
+    std::vector<unsigned char> bytes(frameBytes);
+    while (in.read((char*)bytes.data(), (std::streamsize)frameBytes)) {
+      Boids& frame = frames.emplace_back(boids);
+      if (format == FrameFormat::Float32) {
+        for (size_t i = 0; i < boids; i++) {
+          frame[i].position.x = LoadFloat(&bytes[16 * i]);
+          frame[i].position.y = LoadFloat(&bytes[16 * i + 4]);
+          frame[i].velocity.x = LoadFloat(&bytes[16 * i + 8]);
+          frame[i].velocity.y = LoadFloat(&bytes[16 * i + 12]);
+        }
+      } else {
+        const double centerX = LoadFloat(&bytes[0]), centerY = LoadFloat(&bytes[4]);
+        const double positionStep = LoadFloat(&bytes[8]), velocityStep = LoadFloat(&bytes[12]);
+        auto q = [&](size_t offset) { return (double)(int16_t)LoadLittleEndian(&bytes[offset], 2); };
+        for (size_t i = 0; i < boids; i++) {
+          frame[i].position.x = centerX + q(16 + 8 * i) * positionStep;
+          frame[i].position.y = centerY + q(18 + 8 * i) * positionStep;
+          frame[i].velocity.x = q(20 + 8 * i) * velocityStep;
+          frame[i].velocity.y = q(22 + 8 * i) * velocityStep;
+        }
+      }
+    }
+    if (in.gcount() != 0) throw std::runtime_error("truncated frame stream");
+    return frames;
+  }
+
+private:
+  std::ostream& out;
+  FrameFormat format;
+  std::vector<char> buffer;
+  bool headerWritten = false;
+  size_t boidsPerFrame = 0;
+
+  // same text as std::fixed with std::setprecision(3): both round the exact binary value to nearest
+  void AppendFixed(double value, char separator) {
+    // the largest double has 309 digits before the point
+    char text[320];
+    char* end = std::to_chars(text, text + sizeof(text) - 1, value, std::chars_format::fixed, 3).ptr;
+    *end++ = separator;
+    buffer.insert(buffer.end(), text, end);
+  }
+
+  void AppendBytes(const void* bytes, size_t count) {
+    const char* p = static_cast<const char*>(bytes);
+    buffer.insert(buffer.end(), p, p + count);
+  }
+
+  void AppendLittleEndian(uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) buffer.push_back((char)(value >> (8 * i)));
+  }
+
+  void AppendFloat(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    AppendLittleEndian(bits, 4);
+  }
+
+  static uint64_t LoadLittleEndian(const unsigned char* in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) value |= (uint64_t)in[i] << (8 * i);
+    return value;
+  }
+
+  static float LoadFloat(const unsigned char* in) {
+    const uint32_t bits = (uint32_t)LoadLittleEndian(in, 4);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+  }
+
+  // a float32 step that maps magnitude to at most 32767 steps
+  static float Step(double magnitude) {
+    if (!(magnitude > 0) || !std::isfinite(magnitude)) return 1.0f;
+    float step = (float)(magnitude / 32767);
+    // float rounding may leave the largest value just past 32767 steps
+    while (magnitude / step > 32767) step = std::nextafter(step, INFINITY);
+    return step;
+  }
+
+  static int16_t Quantize(double value, float step) {
+    const double q = std::round(value / step);
+    return (int16_t)std::clamp(q, -32767.0, 32767.0);
+  }
+};
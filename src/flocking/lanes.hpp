@@ -0,0 +1,71 @@
+#pragma once
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+/**
+ * One AVX2 register of T with the operations the force kernels use, so the same kernel runs 4 doubles or
+ * 8 floats per iteration. Comparisons return masks, lanes of all ones or all zeros, meant for And.
+ */
+template <typename T>
+struct Lanes;
+
+template <>
+struct Lanes<double> {
+  using Register = __m256d;
+  static constexpr int Width = 4;
+
+  static Register Set(double value) { return _mm256_set1_pd(value); }
+  static Register Zero() { return _mm256_setzero_pd(); }
+  static Register Load(const double* aligned) { return _mm256_load_pd(aligned); }
+  static Register Add(Register a, Register b) { return _mm256_add_pd(a, b); }
+  static Register Sub(Register a, Register b) { return _mm256_sub_pd(a, b); }
+  static Register Mul(Register a, Register b) { return _mm256_mul_pd(a, b); }
+  static Register Div(Register a, Register b) { return _mm256_div_pd(a, b); }
+  static Register And(Register a, Register b) { return _mm256_and_pd(a, b); }
+  static Register LessEqual(Register a, Register b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+  static Register Greater(Register a, Register b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+
+  // of the lanes first .. first + 3, the ones in [begin, end), and the ones in it that are not self
+  static void IndexMasks(int first, int begin, int end, int self, Register& inRange, Register& other) {
+    const __m256i index = _mm256_add_epi64(_mm256_set1_epi64x(first), _mm256_setr_epi64x(0, 1, 2, 3));
+    const __m256i range = _mm256_andnot_si256(_mm256_cmpgt_epi64(_mm256_set1_epi64x(begin), index), _mm256_cmpgt_epi64(_mm256_set1_epi64x(end), index));
+    inRange = _mm256_castsi256_pd(range);
+    other = _mm256_castsi256_pd(_mm256_andnot_si256(_mm256_cmpeq_epi64(index, _mm256_set1_epi64x(self)), range));
+  }
+
+  static double Sum(Register v) {
+    const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+  }
+};
+
+template <>
+struct Lanes<float> {
+  using Register = __m256;
+  static constexpr int Width = 8;
+
+  static Register Set(float value) { return _mm256_set1_ps(value); }
+  static Register Zero() { return _mm256_setzero_ps(); }
+  static Register Load(const float* aligned) { return _mm256_load_ps(aligned); }
+  static Register Add(Register a, Register b) { return _mm256_add_ps(a, b); }
+  static Register Sub(Register a, Register b) { return _mm256_sub_ps(a, b); }
+  static Register Mul(Register a, Register b) { return _mm256_mul_ps(a, b); }
+  static Register Div(Register a, Register b) { return _mm256_div_ps(a, b); }
+  static Register And(Register a, Register b) { return _mm256_and_ps(a, b); }
+  static Register LessEqual(Register a, Register b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+  static Register Greater(Register a, Register b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+
+  static void IndexMasks(int first, int begin, int end, int self, Register& inRange, Register& other) {
+    const __m256i index = _mm256_add_epi32(_mm256_set1_epi32(first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i range = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(begin), index), _mm256_cmpgt_epi32(_mm256_set1_epi32(end), index));
+    inRange = _mm256_castsi256_ps(range);
+    other = _mm256_castsi256_ps(_mm256_andnot_si256(_mm256_cmpeq_epi32(index, _mm256_set1_epi32(self)), range));
+  }
+
+  static float Sum(Register v) {
+    const __m128 quad = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    const __m128 pair = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+  }
+};
+#endif
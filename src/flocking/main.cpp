@@ -6,7 +6,7 @@ using namespace std;
 // feel free to edit this main function to meet your needs
 int main() {
   Simulator simulator(cin);
-  simulator.Run();
-  simulator.OutputStates(cout);
+  // frames are written as they are computed, nothing is kept
+  simulator.Run(cout);
   return 0;
 }
@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Boid indices sorted along the Z-order (Morton) curve of their positions.
+ *
+ * Build() quantizes every position to 16 bits per axis over the square around the flock, interleaves the bits
+ * into a 32 bit key, x in the even bits, and radix sorts the indices by key. Boids close in space end up close
+ * in the order, and every aligned square of the quantized space is a contiguous range of it. Buffers keep
+ * their capacity, so sorting every step allocates nothing.
+ */
+struct MortonOrder {
+  std::vector<int> indices;
+  std::vector<uint32_t> keys;
+  // the bounding square, every key is relative to it
+  double minX = 0, minY = 0, side = 0;
+
+  // agents is any container of objects with a position
+  template <typename Agents>
+  void Build(const Agents& agents) {
+    const int count = (int)agents.size();
+    keys.resize(count);
+    indices.resize(count);
+    if (count == 0) return;
+
+    minX = (double)agents[0].position.x;
+    minY = (double)agents[0].position.y;
+    double maxX = minX, maxY = minY;
+    for (const auto& agent : agents) {
+      minX = std::min(minX, (double)agent.position.x);
+      maxX = std::max(maxX, (double)agent.position.x);
+      minY = std::min(minY, (double)agent.position.y);
+      maxY = std::max(maxY, (double)agent.position.y);
+    }
+    side = std::max(maxX - minX, maxY - minY);
+    // a diverged simulation gets every key 0
+    const double scale = side > 0 && std::isfinite(side) ? 65535.0 / side : 0.0;
+
+    for (int i = 0; i < count; i++) {
+      keys[i] = MortonKey(Quantize(((double)agents[i].position.x - minX) * scale), Quantize(((double)agents[i].position.y - minY) * scale));
+      indices[i] = i;
+    }
+    RadixSort();
+  }
+
+  static uint32_t MortonKey(uint32_t x, uint32_t y) { return Spread(x) | (Spread(y) << 1); }
+
+private:
+  std::vector<uint32_t> keyBuffer;
+  std::vector<int> indexBuffer;
+
+  static uint32_t Quantize(double offset) {
+    if (!(offset > 0)) return 0;
+    return (uint32_t)std::min(offset, 65535.0);
+  }
+
+  // the 16 low bits of v moved to the even bits
+  static uint32_t Spread(uint32_t v) {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+  }
+
+  // least significant digit first, 8 bits per pass. every pass is stable, so equal keys keep index order
+  void RadixSort() {
+    const int count = (int)keys.size();
+    keyBuffer.resize(count);
+    indexBuffer.resize(count);
+    for (int shift = 0; shift < 32; shift += 8) {
+      std::array<int, 257> start{};
+      for (uint32_t key : keys) start[((key >> shift) & 0xFF) + 1]++;
+      // every key has the same digit, the pass would not move anything
+      if (std::find(start.begin(), start.end(), count) != start.end()) continue;
+      for (int d = 1; d <= 256; d++) start[d] += start[d - 1];
+      for (int i = 0; i < count; i++) {
+        const int slot = start[(keys[i] >> shift) & 0xFF]++;
+        keyBuffer[slot] = keys[i];
+        indexBuffer[slot] = indices[i];
+      }
+      keys.swap(keyBuffer);
+      indices.swap(indexBuffer);
+    }
+  }
+};
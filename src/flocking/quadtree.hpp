@@ -0,0 +1,127 @@
+#pragma once
+#include "morton.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Linear quadtree over the boids, an alternative to SpatialGrid for flocks packed into a few dense clusters.
+ *
+ * Build() sorts the boid indices in Morton order (see MortonOrder), so every quadtree node is a contiguous
+ * range of indices. Nodes are split until they hold at most leafCapacity boids, so a dense cluster ends up in
+ * many small leaves instead of a few crowded grid cells. Boids sharing a key, or nodes at the 16th level, stay
+ * in one leaf whatever its size.
+ *
+ * Nodes keep the tight bounding box of their boids. A query walks down from the root, skipping the nodes
+ * whose box is farther than the radius given to Build, and reports the leaves it reaches as ranges of
+ * indices, the same interface as SpatialGrid.
+ */
+struct LinearQuadtree : MortonOrder {
+  static constexpr int Levels = 16;
+  int leafCapacity = 16;
+
+  struct Node {
+    double minX, minY, maxX, maxY;
+    // boids indices[begin] .. indices[end - 1], and children nodes[firstChild] .. nodes[firstChild + children - 1]
+    int begin, end;
+    int firstChild, children;
+  };
+
+  double radius = 0;
+  std::vector<Node> nodes;
+
+  // agents is any container of objects with a position, as for SpatialGrid::Build
+  template <typename Agents>
+  void Build(const Agents& agents, double radius) {
+    this->radius = radius;
+    nodes.clear();
+    MortonOrder::Build(agents);
+    const int count = (int)agents.size();
+    if (count == 0) return;
+    nodes.push_back({0, 0, 0, 0, 0, count, -1, 0});
+    BuildNode(agents, 0, 0);
+  }
+
+  // calls visit(begin, end) for every leaf that may hold boids within the radius of position
+  template <typename Position, typename Visit>
+  void ForEachCandidateRange(const Position& position, Visit&& visit) const {
+    if (nodes.empty()) return;
+    const double x = (double)position.x, y = (double)position.y;
+    // a little slack, so float flocks, whose distances round differently, lose no neighbor on the boundary
+    const double reach = radius * radius * (1 + 1e-6);
+    // every level leaves at most 3 siblings waiting
+    std::array<int, 4 * Levels + 4> stack;
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      const Node& node = nodes[stack[--top]];
+      const double dx = std::max({node.minX - x, 0.0, x - node.maxX});
+      const double dy = std::max({node.minY - y, 0.0, y - node.maxY});
+      if (!(dx * dx + dy * dy <= reach)) continue;
+      if (node.children == 0) {
+        visit(node.begin, node.end);
+        continue;
+      }
+      // pushed backwards so leaves come out in index order
+      for (int c = node.children - 1; c >= 0; c--) stack[top++] = node.firstChild + c;
+    }
+  }
+
+  // calls visit(index) for every boid of those leaves. the caller filters by distance
+  template <typename Position, typename Visit>
+  void ForEachCandidate(const Position& position, Visit&& visit) const {
+    ForEachCandidateRange(position, [&](int begin, int end) {
+      for (int k = begin; k < end; k++) visit(indices[k]);
+    });
+  }
+
+private:
+  // splits node n, at the given depth, into its non empty quadrants, and sets the bounding boxes bottom up
+  template <typename Agents>
+  void BuildNode(const Agents& agents, int n, int level) {
+    const int begin = nodes[n].begin, end = nodes[n].end;
+    if (end - begin <= leafCapacity || level == Levels || keys[begin] == keys[end - 1]) {
+      Node& leaf = nodes[n];
+      const auto& first = agents[indices[begin]].position;
+      leaf.minX = leaf.maxX = (double)first.x;
+      leaf.minY = leaf.maxY = (double)first.y;
+      for (int k = begin + 1; k < end; k++) {
+        const auto& position = agents[indices[k]].position;
+        leaf.minX = std::min(leaf.minX, (double)position.x);
+        leaf.maxX = std::max(leaf.maxX, (double)position.x);
+        leaf.minY = std::min(leaf.minY, (double)position.y);
+        leaf.maxY = std::max(leaf.maxY, (double)position.y);
+      }
+      return;
+    }
+
+    // the quadrant is the next 2 bits of the key below the ones the node shares
+    const int shift = 2 * (Levels - 1 - level);
+    const int firstChild = (int)nodes.size();
+    int split = begin;
+    for (uint32_t quadrant = 0; quadrant < 4 && split < end; quadrant++) {
+      const int childEnd = (int)(std::upper_bound(keys.begin() + split, keys.begin() + end, quadrant, [&](uint32_t q, uint32_t key) { return q < ((key >> shift) & 3); }) - keys.begin());
+      if (childEnd > split) nodes.push_back({0, 0, 0, 0, split, childEnd, -1, 0});
+      split = childEnd;
+    }
+    const int children = (int)nodes.size() - firstChild;
+    nodes[n].firstChild = firstChild;
+    nodes[n].children = children;
+
+    // nodes grows during the recursion, so no reference into it is held across it
+    for (int c = 0; c < children; c++) BuildNode(agents, firstChild + c, level + 1);
+    Node box = nodes[firstChild];
+    for (int c = 1; c < children; c++) {
+      const Node& child = nodes[firstChild + c];
+      box.minX = std::min(box.minX, child.minX);
+      box.minY = std::min(box.minY, child.minY);
+      box.maxX = std::max(box.maxX, child.maxX);
+      box.maxY = std::max(box.maxY, child.maxY);
+    }
+    nodes[n].minX = box.minX;
+    nodes[n].minY = box.minY;
+    nodes[n].maxX = box.maxX;
+    nodes[n].maxY = box.maxY;
+  }
+};
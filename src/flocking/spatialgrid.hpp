@@ -0,0 +1,106 @@
+#pragma once
+#include "vector2.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * Uniform grid over the bounding box of the boids, used to find neighbors without scanning the whole flock.
+ *
+ * Build() counting sorts the boid indices by cell into one flat array: the boids of cell c are
+ * indices[cellStart[c]] .. indices[cellStart[c + 1] - 1], in increasing index order. There are no per cell
+ * containers, so rebuilding every frame only touches three arrays that keep their capacity.
+ *
+ * Cells are at least as wide as the search radius, so every boid within the radius of a point is in the 3x3
+ * block of cells around it.
+ */
+struct SpatialGrid {
+  double cellSize = 1;
+  double minX = 0, minY = 0;
+  int columns = 0, rows = 0;
+  std::vector<int> cellStart;
+  std::vector<int> indices;
+
+  // agents is any container of objects with a Vector2 position
+  template <typename Agents>
+  void Build(const Agents& agents, double radius) {
+    const int count = (int)agents.size();
+    indices.resize(count);
+    cellOf.resize(count);
+    if (count == 0) {
+      columns = rows = 0;
+      cellStart.assign(1, 0);
+      return;
+    }
+
+    double maxX = (double)agents[0].position.x, maxY = (double)agents[0].position.y;
+    minX = maxX;
+    minY = maxY;
+    for (const auto& agent : agents) {
+      minX = std::min(minX, (double)agent.position.x);
+      maxX = std::max(maxX, (double)agent.position.x);
+      minY = std::min(minY, (double)agent.position.y);
+      maxY = std::max(maxY, (double)agent.position.y);
+    }
+
+    // a sparse flock over a wide area would need far more cells than boids. cells are widened until there
+    // are a few per boid, wider cells still find every neighbor in the 3x3 block
+    const double width = maxX - minX, height = maxY - minY;
+    const double maxCells = 4.0 * count + 16;
+    cellSize = std::max(radius, 1e-9);
+    if (std::isfinite(width) && std::isfinite(height)) {
+      while ((std::floor(width / cellSize) + 1) * (std::floor(height / cellSize) + 1) > maxCells) cellSize *= 2;
+      columns = (int)std::floor(width / cellSize) + 1;
+      rows = (int)std::floor(height / cellSize) + 1;
+    } else {
+      // diverged simulation, everything goes in one cell
+      columns = rows = 1;
+    }
+
+    // counting sort. counts go to the slot of each cell, the inclusive prefix sum turns them into the end
+    // of every cell, and filling backwards moves them to the start while keeping the indices ordered
+    cellStart.assign(columns * rows + 1, 0);
+    for (int i = 0; i < count; i++) {
+      cellOf[i] = CellOf(agents[i].position);
+      cellStart[cellOf[i]]++;
+    }
+    for (int c = 1; c <= columns * rows; c++) cellStart[c] += cellStart[c - 1];
+    for (int i = count - 1; i >= 0; i--) indices[--cellStart[cellOf[i]]] = i;
+  }
+
+  // calls visit(index) for every boid in the 3x3 cells around position, a BasicVector2 of any scalar type.
+  // the caller filters by distance
+  template <typename Position, typename Visit>
+  void ForEachCandidate(const Position& position, Visit&& visit) const {
+    ForEachCandidateRange(position, [&](int begin, int end) {
+      for (int k = begin; k < end; k++) visit(indices[k]);
+    });
+  }
+
+  // same candidates as ranges [begin, end) of positions in indices, one per row of cells since the cells of
+  // a row are contiguous. arrays gathered in indices order hold the candidates contiguously
+  template <typename Position, typename Visit>
+  void ForEachCandidateRange(const Position& position, Visit&& visit) const {
+    if (columns == 0) return;
+    const int cx = Coordinate(position.x - minX, columns), cy = Coordinate(position.y - minY, rows);
+    const int x0 = std::max(cx - 1, 0), x1 = std::min(cx + 1, columns - 1);
+    for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows - 1); y++) {
+      const int begin = cellStart[y * columns + x0], end = cellStart[y * columns + x1 + 1];
+      if (begin < end) visit(begin, end);
+    }
+  }
+
+  template <typename Position>
+  int CellOf(const Position& position) const { return Coordinate(position.y - minY, rows) * columns + Coordinate(position.x - minX, columns); }
+
+private:
+  std::vector<int> cellOf;
+
+  // cell coordinate of an offset from the grid origin, clamped to the grid
+  int Coordinate(double offset, int cells) const {
+    const double c = std::floor(offset / cellSize);
+    if (!(c >= 0)) return 0;
+    if (c >= cells - 1) return cells - 1;
+    return (int)c;
+  }
+};
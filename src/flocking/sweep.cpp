@@ -0,0 +1,45 @@
+// Runs every variant of a parameter sweep on one starting flock and prints their final metrics.
+// usage: flocking-sweep specification flock [threads]   flock is simulator input, threads default to all
+// results are written to stdout as JSON, one object per variant in sweep order
+#include "sweep.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "usage: flocking-sweep specification flock [threads]" << std::endl;
+    return 1;
+  }
+  std::ifstream specification(argv[1]), flock(argv[2]);
+  if (!specification || !flock) {
+    std::cerr << "cannot open " << (!specification ? argv[1] : argv[2]) << std::endl;
+    return 1;
+  }
+  const int threads = argc > 3 ? std::stoi(argv[3]) : 0;
+
+  Sweep sweep;
+  try {
+    sweep = Sweep::Read(specification, flock);
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  const auto variants = sweep.Variants();
+  std::cerr << "running " << variants.size() << " variants of " << sweep.boids.size() << " boids for " << sweep.steps << " steps..." << std::endl;
+  const auto results = sweep.Run(threads);
+
+  std::cout << "{\n  \"boids\": " << sweep.boids.size() << ",\n  \"steps\": " << sweep.steps << ",\n  \"deltaTime\": " << sweep.deltaTime
+            << ",\n  \"variants\": [\n";
+  for (size_t v = 0; v < variants.size(); v++) {
+    const FlockingParameters& p = variants[v];
+    const FlockMetrics& m = results[v];
+    std::cout << "    {\"cohesionRadius\": " << p.cohesionRadius << ", \"separationRadius\": " << p.separationRadius
+              << ", \"separationMaxForce\": " << p.separationMaxForce << ", \"alignmentRadius\": " << p.alignmentRadius
+              << ", \"cohesionK\": " << p.cohesionK << ", \"separationK\": " << p.separationK << ", \"alignmentK\": " << p.alignmentK
+              << ", \"meanSpeed\": " << m.meanSpeed << ", \"polarization\": " << m.polarization
+              << ", \"meanNearestNeighbor\": " << m.meanNearestNeighbor << "}" << (v + 1 < variants.size() ? ",\n" : "\n");
+  }
+  std::cout << "  ]\n}" << std::endl;
+  return 0;
+}
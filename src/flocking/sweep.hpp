@@ -0,0 +1,155 @@
+#pragma once
+#include "flocking.hpp"
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// summary of a flock state, for comparing many runs without keeping their trajectories
+struct FlockMetrics {
+  double meanSpeed = 0;
+  // length of the mean unit velocity: 1 when every boid heads the same way, near 0 when headings cancel out
+  double polarization = 0;
+  // mean over the boids of the distance to their nearest other boid
+  double meanNearestNeighbor = 0;
+
+  static FlockMetrics Measure(const std::vector<Boid>& boids) {
+    FlockMetrics metrics;
+    const int count = (int)boids.size();
+    if (count == 0) return metrics;
+    Vector2 heading;
+    for (const Boid& boid : boids) {
+      const double speed = boid.velocity.getMagnitude();
+      metrics.meanSpeed += speed;
+      if (speed > 0) heading += boid.velocity / speed;
+    }
+    metrics.meanSpeed /= count;
+    metrics.polarization = heading.getMagnitude() / count;
+    if (count < 2) return metrics;
+
+    // cells as wide as the typical spacing. a neighbor found in the 3x3 cells no farther than a cell is the
+    // nearest, since every boid outside them is farther than that. otherwise fall back to every boid
+    double minX = boids[0].position.x, maxX = minX, minY = boids[0].position.y, maxY = minY;
+    for (const Boid& boid : boids) {
+      minX = std::min(minX, boid.position.x);
+      maxX = std::max(maxX, boid.position.x);
+      minY = std::min(minY, boid.position.y);
+      maxY = std::max(maxY, boid.position.y);
+    }
+    SpatialGrid grid;
+    grid.Build(boids, std::sqrt(std::max((maxX - minX) * (maxY - minY), 1e-18) / count));
+    for (int i = 0; i < count; i++) {
+      double nearest = std::numeric_limits<double>::infinity();
+      grid.ForEachCandidate(boids[i].position, [&](int j) {
+        if (j != i) nearest = std::min(nearest, boids[i].position.DistanceSquared(boids[j].position));
+      });
+      if (!(nearest <= grid.cellSize * grid.cellSize)) {
+        for (int j = 0; j < count; j++) {
+          if (j != i) nearest = std::min(nearest, boids[i].position.DistanceSquared(boids[j].position));
+        }
+      }
+      metrics.meanNearestNeighbor += std::sqrt(nearest);
+    }
+    metrics.meanNearestNeighbor /= count;
+    return metrics;
+  }
+};
+
+/**
+ * Many short simulations of one starting flock with different parameters, run side by side on a thread pool.
+ *
+ * A specification lists the number of steps, the time step and, for any of the parameters, the values to try:
+ *
+ *     steps 200
+ *     deltaTime 0.05
+ *     cohesionK 0.5 1 2
+ *     separationRadius 1 1.5
+ *
+ * Variants are every combination of the listed values, the last parameter varying fastest, and the parameters
+ * that are not listed keep their value from the base flock. Lines starting with # are comments. Every variant
+ * starts from the same boids, which are shared read only, and only its final metrics are kept.
+ */
+struct Sweep {
+  FlockingParameters base;
+  std::vector<Boid> boids;
+  int steps = 100;
+  double deltaTime = 0.05;
+  std::vector<std::pair<std::string, std::vector<double>>> axes;
+
+  // parameter names, as in the specification, and where they live in FlockingParameters
+  static double& Parameter(FlockingParameters& parameters, const std::string& name) {
+    if (name == "cohesionRadius") return parameters.cohesionRadius;
+    if (name == "separationRadius") return parameters.separationRadius;
+    if (name == "separationMaxForce") return parameters.separationMaxForce;
+    if (name == "alignmentRadius") return parameters.alignmentRadius;
+    if (name == "cohesionK") return parameters.cohesionK;
+    if (name == "separationK") return parameters.separationK;
+    if (name == "alignmentK") return parameters.alignmentK;
+    throw std::invalid_argument("unknown sweep parameter " + name);
+  }
+
+  // the base flock is read as simulator input: parameters, boids, and time steps, which are ignored
+  static Sweep Read(std::istream& specification, std::istream& flock) {
+    Sweep sweep;
+    Simulator simulator(flock);
+    if (flock.fail()) throw std::invalid_argument("sweep base flock is truncated or malformed");
+    sweep.base = simulator.GetFlocking().GetParameters();
+    sweep.boids = simulator.GetFlocking().GetCurrentState();
+
+    std::string line;
+    while (std::getline(specification, line)) {
+      std::istringstream fields(line);
+      std::string name;
+      if (!(fields >> name) || name[0] == '#') continue;
+      if (name == "steps") {
+        if (!(fields >> sweep.steps) || sweep.steps < 0) throw std::invalid_argument("sweep steps must be a count");
+      } else if (name == "deltaTime") {
+        if (!(fields >> sweep.deltaTime)) throw std::invalid_argument("sweep deltaTime must be a number");
+      } else {
+        Parameter(sweep.base, name);
+        std::vector<double> values;
+        for (double value; fields >> value;) values.push_back(value);
+        if (!fields.eof()) throw std::invalid_argument("sweep values of " + name + " must be numbers");
+        if (values.empty()) throw std::invalid_argument("sweep parameter " + name + " has no values");
+        sweep.axes.emplace_back(name, std::move(values));
+      }
+    }
+    return sweep;
+  }
+
+  std::vector<FlockingParameters> Variants() const {
+    std::vector<FlockingParameters> variants = {base};
+    for (const auto& [name, values] : axes) {
+      std::vector<FlockingParameters> next;
+      next.reserve(variants.size() * values.size());
+      for (const FlockingParameters& variant : variants) {
+        for (double value : values) {
+          next.push_back(variant);
+          Parameter(next.back(), name) = value;
+        }
+      }
+      variants = std::move(next);
+    }
+    return variants;
+  }
+
+  // metrics after the last step of every variant, in Variants() order. threads 0 is one per hardware thread
+  std::vector<FlockMetrics> Run(int threads = 0) const {
+    const std::vector<FlockingParameters> variants = Variants();
+    std::vector<FlockMetrics> results(variants.size());
+    WorkStealingPool pool(threads);
+    // one variant per chunk: each one is a whole simulation, stepped on the thread that took it
+    pool.ParallelFor((int)variants.size(), 1, [&](int begin, int end) {
+      for (int v = begin; v < end; v++) {
+        Flocking flocking(variants[v], boids);
+        for (int step = 0; step < steps; step++) flocking.Step(deltaTime);
+        results[v] = FlockMetrics::Measure(flocking.GetCurrentState());
+      }
+    });
+    return results;
+  }
+};
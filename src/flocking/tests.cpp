@@ -7,7 +7,14 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <iomanip>
+#include <cstring>
 #include "flocking.hpp"
+#include "sweep.hpp"
 #include "MemoryLeakDetector.h"
 
 namespace fs = std::filesystem;
@@ -47,10 +54,8 @@ bool isClose(double a, double b, double tolerance = 1e-6) {
 std::string runFlockingSimulation(const std::string& input) {
     std::istringstream inputStream(input);
     Simulator simulator(inputStream);
-    simulator.Run();
-    
     std::ostringstream outputStream;
-    simulator.OutputStates(outputStream);
+    simulator.Run(outputStream);
 
     return outputStream.str();
 }
@@ -170,4 +175,844 @@ TEST_CASE("Flocking simulation tests") {
             runTestCase(testName, inputFile, outputFile);
         }
     }
-}
\ No newline at end of file
+}
+// deterministic flock spread over a square, with some boids stacked on the same spot
+std::vector<Boid> randomFlock(int count, double side, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> position(0, side), velocity(-1, 1);
+    std::vector<Boid> boids;
+    for (int i = 0; i < count; i++) {
+        boids.emplace_back(Vector2(position(generator), position(generator)), Vector2(velocity(generator), velocity(generator)));
+    }
+    for (int i = 0; i + 1 < count; i += 97) {
+        boids[i + 1].position = boids[i].position;
+    }
+    return boids;
+}
+
+bool isClose(const Vector2& a, const Vector2& b) {
+    return isClose(a.x, b.x) && isClose(a.y, b.y);
+}
+
+TEST_CASE("Spatial grid neighbor queries") {
+    SUBCASE("Forces match brute force") {
+        for (double side : {10.0, 100.0, 10000.0}) {
+            auto boids = randomFlock(2000, side, 7);
+            Cohesion cohesion(2.5, 1.5);
+            Alignment alignment(1.0, 0.7);
+            Separation separation(4.0, 2.0, 3.0);
+            SpatialGrid grid;
+            grid.Build(boids, 4.0);
+            for (int i = 0; i < (int)boids.size(); i++) {
+                REQUIRE(isClose(cohesion.ComputeForce(boids, i, grid), cohesion.ComputeForce(boids, i)));
+                REQUIRE(isClose(alignment.ComputeForce(boids, i, grid), alignment.ComputeForce(boids, i)));
+                REQUIRE(isClose(separation.ComputeForce(boids, i, grid), separation.ComputeForce(boids, i)));
+            }
+        }
+    }
+
+    SUBCASE("Cells hold every boid once, in index order") {
+        auto boids = randomFlock(1000, 50, 3);
+        SpatialGrid grid;
+        grid.Build(boids, 2.0);
+        CHECK(grid.cellSize >= 2.0);
+        REQUIRE(grid.cellStart.size() == (size_t)grid.columns * grid.rows + 1);
+        CHECK(grid.cellStart.back() == 1000);
+        std::vector<int> seen(boids.size(), 0);
+        for (int c = 0; c < grid.columns * grid.rows; c++) {
+            for (int k = grid.cellStart[c]; k < grid.cellStart[c + 1]; k++) {
+                CHECK(grid.CellOf(boids[grid.indices[k]].position) == c);
+                if (k > grid.cellStart[c]) CHECK(grid.indices[k - 1] < grid.indices[k]);
+                seen[grid.indices[k]]++;
+            }
+        }
+        CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+    }
+
+    SUBCASE("Sparse flocks do not allocate a cell per unit of area") {
+        std::vector<Boid> boids = {Boid({0, 0}, {0, 0}), Boid({1e9, 1e9}, {0, 0})};
+        SpatialGrid grid;
+        grid.Build(boids, 1.0);
+        CHECK(grid.columns * grid.rows <= 4 * 2 + 16);
+        int candidates = 0;
+        grid.ForEachCandidate(boids[0].position, [&](int) { candidates++; });
+        CHECK(candidates >= 1);
+    }
+
+    SUBCASE("Steps match brute force") {
+        auto boids = randomFlock(500, 20, 11);
+        Flocking flocking(2.0, 1.0, 2.0, 1.5, 1.0, 1.5, 0.5, boids);
+        Cohesion cohesion(2.0, 1.0);
+        Alignment alignment(1.5, 0.5);
+        Separation separation(1.0, 1.5, 2.0);
+        std::vector<Boid> expected = boids;
+        for (int step = 0; step < 3; step++) {
+            flocking.Step(0.1);
+            std::vector<Boid> next = expected;
+            for (int i = 0; i < (int)expected.size(); i++) {
+                Vector2 force = cohesion.ComputeForce(expected, i) + alignment.ComputeForce(expected, i) + separation.ComputeForce(expected, i);
+                next[i].velocity = expected[i].velocity + force * 0.1;
+                next[i].position = expected[i].position + next[i].velocity * 0.1;
+            }
+            expected = next;
+        }
+        for (int i = 0; i < (int)expected.size(); i++) {
+            REQUIRE(isClose(flocking.GetCurrentState()[i].position, expected[i].position));
+            REQUIRE(isClose(flocking.GetCurrentState()[i].velocity, expected[i].velocity));
+        }
+    }
+}
+
+TEST_CASE("Fused steering kernel") {
+    auto boids = randomFlock(3000, 60, 5);
+    // cohesion, separation and alignment radii all different, so each force sees its own neighbors
+    Flocking flocking(3.0, 1.0, 2.5, 2.0, 1.2, 1.7, 0.4, boids);
+    Cohesion cohesion(3.0, 1.2);
+    Alignment alignment(2.0, 0.4);
+    Separation separation(1.0, 1.7, 2.5);
+    SpatialGrid grid;
+    grid.Build(boids, 3.0);
+    for (int i = 0; i < (int)boids.size(); i++) {
+        Vector2 fused = flocking.ComputeForce(boids, i, grid);
+        Vector2 separate = cohesion.ComputeForce(boids, i, grid) + alignment.ComputeForce(boids, i, grid) + separation.ComputeForce(boids, i, grid);
+        // same neighbors visited in the same order, so the sums are bit for bit the same
+        REQUIRE(fused.x == separate.x);
+        REQUIRE(fused.y == separate.y);
+    }
+}
+
+TEST_CASE("Structure of arrays storage") {
+    auto boids = randomFlock(3000, 60, 13);
+    Flocking flocking(3.0, 1.0, 2.5, 2.0, 1.2, 1.7, 0.4, boids);
+
+    SUBCASE("Forces match the boid kernel") {
+        SpatialGrid grid;
+        grid.Build(boids, 3.0);
+        BoidArrays sorted;
+        sorted.Gather(boids, grid.indices);
+        CHECK(reinterpret_cast<uintptr_t>(sorted.x.data()) % 32 == 0);
+        CHECK(sorted.x.size() % BoidArrays::Width == 0);
+        for (int k = 0; k < (int)boids.size(); k++) {
+            REQUIRE(isClose(flocking.ComputeForce(sorted, k, grid), flocking.ComputeForce(boids, grid.indices[k], grid)));
+        }
+    }
+
+    SUBCASE("Steps match the boid storage") {
+        Flocking soa = flocking;
+        soa.storage = Flocking::Storage::StructOfArrays;
+        for (int step = 0; step < 5; step++) {
+            flocking.Step(0.05);
+            soa.Step(0.05);
+        }
+        for (int i = 0; i < (int)boids.size(); i++) {
+            REQUIRE(isClose(soa.GetCurrentState()[i].position, flocking.GetCurrentState()[i].position));
+            REQUIRE(isClose(soa.GetCurrentState()[i].velocity, flocking.GetCurrentState()[i].velocity));
+        }
+    }
+}
+
+TEST_CASE("Parallel step") {
+    SUBCASE("Every index runs once, whatever the imbalance") {
+        WorkStealingPool pool(4);
+        std::vector<int> hits(10000, 0);
+        pool.ParallelFor((int)hits.size(), 7, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                // the first chunks are much slower than the others, so the other threads have to steal them
+                if (i < 1000) std::this_thread::sleep_for(std::chrono::microseconds(20));
+                hits[i]++;
+            }
+        });
+        CHECK(std::all_of(hits.begin(), hits.end(), [](int n) { return n == 1; }));
+
+        CHECK_THROWS_AS(pool.ParallelFor(100, 10, [](int begin, int) {
+            if (begin == 50) throw std::runtime_error("chunk failed");
+        }), std::runtime_error);
+    }
+
+    SUBCASE("Results do not depend on the thread count") {
+        auto boids = randomFlock(4000, 80, 17);
+        for (auto storage : {Flocking::Storage::ArrayOfStructs, Flocking::Storage::StructOfArrays}) {
+            Flocking serial(3.0, 1.0, 2.5, 2.0, 1.2, 1.7, 0.4, boids);
+            serial.storage = storage;
+            for (int step = 0; step < 3; step++) serial.Step(0.05);
+
+            for (int threads : {2, 3, 8}) {
+                Flocking parallel(3.0, 1.0, 2.5, 2.0, 1.2, 1.7, 0.4, boids);
+                parallel.storage = storage;
+                parallel.SetThreads(threads);
+                CHECK(parallel.GetThreads() == threads);
+                for (int step = 0; step < 3; step++) parallel.Step(0.05);
+                for (int i = 0; i < (int)boids.size(); i++) {
+                    const Boid& a = parallel.GetCurrentState()[i];
+                    const Boid& b = serial.GetCurrentState()[i];
+                    REQUIRE(a.position.x == b.position.x);
+                    REQUIRE(a.position.y == b.position.y);
+                    REQUIRE(a.velocity.x == b.velocity.x);
+                    REQUIRE(a.velocity.y == b.velocity.y);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Streaming output") {
+    std::ifstream inFile;
+    for (const auto& [inputFile, outputFile] : findTestFiles()) {
+        if (fs::path(inputFile).stem() == "cohesion_three_boids") inFile.open(inputFile);
+    }
+    if (!inFile.is_open()) {
+        WARN("No test files found. Make sure test files are copied to the build directory.");
+        return;
+    }
+    const std::string input((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+
+    std::istringstream streamedInput(input);
+    Simulator streamed(streamedInput);
+    std::ostringstream streamedOutput;
+    streamed.Run(streamedOutput);
+    CHECK(streamed.GetStates().empty());
+    std::ostringstream noHistory;
+    CHECK_THROWS_AS(streamed.OutputStates(noHistory), std::logic_error);
+
+    SUBCASE("History is opt in and gives the same text") {
+        std::istringstream historyInput(input);
+        Simulator history(historyInput, true);
+        history.Run();
+        REQUIRE(history.GetStates().size() == 2);
+        std::ostringstream historyOutput;
+        history.OutputStates(historyOutput);
+        CHECK(historyOutput.str() == streamedOutput.str());
+    }
+
+    SUBCASE("Decimation keeps every Nth frame") {
+        std::istringstream decimatedInput(input);
+        Simulator decimated(decimatedInput);
+        std::ostringstream decimatedOutput;
+        decimated.Run(decimatedOutput, 2);
+        // three boids, two frames: only the second one is written
+        const std::string full = streamedOutput.str();
+        size_t secondFrame = 0;
+        for (int line = 0; line < 3; line++) secondFrame = full.find('\n', secondFrame) + 1;
+        CHECK(decimatedOutput.str() == full.substr(secondFrame));
+    }
+}
+
+TEST_CASE("Frame writer") {
+    auto boids = randomFlock(500, 200, 11);
+    // values iostream and to_chars could round differently if either got it wrong: halfway cases, signed zeros
+    boids[0] = Boid(Vector2(-0.0, -0.0004), Vector2(0.0005, 2.0625));
+    boids[1] = Boid(Vector2(-1e-9, 1e15), Vector2(-123456.7895, 0.1235));
+
+    SUBCASE("Text matches iostream fixed formatting") {
+        std::ostringstream expected;
+        expected << std::fixed << std::setprecision(3);
+        for (const Boid& boid : boids) {
+            expected << boid.position.x << " " << boid.position.y << " " << boid.velocity.x << " " << boid.velocity.y << '\n';
+        }
+        std::ostringstream actual;
+        {
+            FrameWriter writer(actual);
+            writer.Write(boids);
+            writer.Write(boids);
+        }
+        CHECK(actual.str() == expected.str() + expected.str());
+    }
+
+    boids[1] = Boid(Vector2(-1e-9, 150), Vector2(-3.5, 0.1235));
+
+    SUBCASE("Float32 frames read back as floats") {
+        std::stringstream binary;
+        {
+            FrameWriter writer(binary, FrameFormat::Float32);
+            writer.Write(boids);
+            writer.Write(boids);
+            CHECK_THROWS_AS(writer.Write(std::vector<Boid>(3)), std::invalid_argument);
+        }
+        const std::string bytes = binary.str();
+        REQUIRE(bytes.size() == FrameWriter::HeaderSize + 2 * boids.size() * 16);
+        CHECK(bytes.substr(0, 4) == "BOID");
+        // little endian whatever the host: format 1, then the boid count
+        CHECK(bytes[6] == 1);
+        CHECK(bytes[7] == 0);
+        CHECK((unsigned char)bytes[8] == (boids.size() & 0xFF));
+        CHECK((unsigned char)bytes[9] == (boids.size() >> 8));
+
+        const auto frames = FrameWriter::ReadBinary<std::vector<Boid>>(binary);
+        REQUIRE(frames.size() == 2);
+        for (const auto& frame : frames) {
+            REQUIRE(frame.size() == boids.size());
+            for (size_t i = 0; i < boids.size(); i++) {
+                REQUIRE(frame[i].position.x == (float)boids[i].position.x);
+                REQUIRE(frame[i].position.y == (float)boids[i].position.y);
+                REQUIRE(frame[i].velocity.x == (float)boids[i].velocity.x);
+                REQUIRE(frame[i].velocity.y == (float)boids[i].velocity.y);
+            }
+        }
+    }
+
+    SUBCASE("Int16 frames are within half a step") {
+        std::stringstream binary;
+        {
+            FrameWriter writer(binary, FrameFormat::Int16);
+            writer.Write(boids);
+        }
+        REQUIRE(binary.str().size() == FrameWriter::HeaderSize + 16 + boids.size() * 8);
+        const auto frames = FrameWriter::ReadBinary<std::vector<Boid>>(binary);
+        REQUIRE(frames.size() == 1);
+        // positions span about 200 units, velocities 3.5: steps of 200 / 2 / 32767 and 3.5 / 32767
+        const double positionError = 100.0 / 32767 * 0.51, velocityError = 3.5 / 32767 * 0.51;
+        for (size_t i = 0; i < boids.size(); i++) {
+            REQUIRE(std::abs(frames[0][i].position.x - boids[i].position.x) <= positionError);
+            REQUIRE(std::abs(frames[0][i].position.y - boids[i].position.y) <= positionError);
+            REQUIRE(std::abs(frames[0][i].velocity.x - boids[i].velocity.x) <= velocityError);
+            REQUIRE(std::abs(frames[0][i].velocity.y - boids[i].velocity.y) <= velocityError);
+        }
+    }
+
+    SUBCASE("Truncated streams are rejected") {
+        std::stringstream binary;
+        {
+            FrameWriter writer(binary, FrameFormat::Float32);
+            writer.Write(boids);
+        }
+        std::string bytes = binary.str();
+        bytes.pop_back();
+        std::istringstream truncated(bytes);
+        CHECK_THROWS_AS(FrameWriter::ReadBinary<std::vector<Boid>>(truncated), std::runtime_error);
+        std::istringstream text("0.000 0.000 0.000 0.000\n");
+        CHECK_THROWS_AS(FrameWriter::ReadBinary<std::vector<Boid>>(text), std::runtime_error);
+    }
+}
+
+TEST_CASE("Single precision flocking") {
+    // the same flock in both precisions, so the only difference is the arithmetic
+    std::vector<BasicBoid<float>> floats;
+    std::vector<Boid> doubles;
+    for (const Boid& boid : randomFlock(3000, 20, 5)) {
+        floats.emplace_back(BasicVector2<float>((float)boid.position.x, (float)boid.position.y), BasicVector2<float>((float)boid.velocity.x, (float)boid.velocity.y));
+        const auto& rounded = floats.back();
+        doubles.emplace_back(Vector2(rounded.position.x, rounded.position.y), Vector2(rounded.velocity.x, rounded.velocity.y));
+    }
+    BasicFlocking<float> single(2.0f, 1.0f, 2.0f, 1.5f, 1.0f, 1.5f, 0.5f, floats);
+    Flocking reference(2.0, 1.0, 2.0, 1.5, 1.0, 1.5, 0.5, doubles);
+
+    SUBCASE("Forces match the double path within 1e-3") {
+        SpatialGrid grid;
+        grid.Build(doubles, 2.0);
+        BasicBoidArrays<float> sorted;
+        sorted.Gather(floats, grid.indices);
+        for (int k = 0; k < (int)doubles.size(); k++) {
+            const int i = grid.indices[k];
+            const Vector2 expected = reference.ComputeForce(doubles, i, grid);
+            for (const BasicVector2<float>& actual : {single.ComputeForce(floats, i, grid), single.ComputeForce(sorted, k, grid)}) {
+                REQUIRE(isClose(actual.x, expected.x, 1e-3));
+                REQUIRE(isClose(actual.y, expected.y, 1e-3));
+            }
+        }
+    }
+
+    SUBCASE("Steps stay close to the double path") {
+        single.storage = BasicFlocking<float>::Storage::StructOfArrays;
+        for (int step = 0; step < 10; step++) {
+            single.Step(0.05f);
+            reference.Step(0.05);
+        }
+        for (size_t i = 0; i < doubles.size(); i++) {
+            REQUIRE(isClose(single.GetCurrentState()[i].position.x, reference.GetCurrentState()[i].position.x, 1e-3));
+            REQUIRE(isClose(single.GetCurrentState()[i].position.y, reference.GetCurrentState()[i].position.y, 1e-3));
+        }
+    }
+
+    SUBCASE("Fixtures match within float precision") {
+        for (const auto& [inputFile, outputFile] : findTestFiles()) {
+            std::ifstream inFile(inputFile), outFile(outputFile);
+            std::istringstream input(normalizeLineEndings(std::string((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>())));
+            std::istringstream expected(normalizeLineEndings(std::string((std::istreambuf_iterator<char>(outFile)), std::istreambuf_iterator<char>())));
+            BasicSimulator<float> simulator(input);
+            std::ostringstream output;
+            simulator.Run(output);
+            std::istringstream actual(output.str());
+            INFO("Test case: " << inputFile);
+            double actualValue, expectedValue;
+            int values = 0;
+            while (actual >> actualValue && expected >> expectedValue) {
+                // float resolution is coarser than the 3 output decimals past a few thousand
+                CHECK(isClose(actualValue, expectedValue, 1e-3 + 1e-6 * std::abs(expectedValue)));
+                values++;
+            }
+            CHECK(values > 0);
+        }
+    }
+}
+
+TEST_CASE("Quadtree neighbor index") {
+    // a wide sparse flock with most boids piled into two small clusters
+    auto boids = randomFlock(3000, 1000, 9);
+    for (int i = 0; i < 2500; i++) {
+        boids[i].position = boids[i].position * 0.002 + Vector2(i % 2 == 0 ? 100 : 700, 400);
+    }
+
+    SUBCASE("Leaves cover every neighbor within the radius") {
+        LinearQuadtree quadtree;
+        quadtree.leafCapacity = 8;
+        quadtree.Build(boids, 0.5);
+        REQUIRE(quadtree.indices.size() == boids.size());
+        for (size_t k = 1; k < quadtree.keys.size(); k++) {
+            REQUIRE(quadtree.keys[k - 1] <= quadtree.keys[k]);
+            if (quadtree.keys[k - 1] == quadtree.keys[k]) REQUIRE(quadtree.indices[k - 1] < quadtree.indices[k]);
+        }
+        for (const auto& node : quadtree.nodes) {
+            if (node.children == 0 && quadtree.keys[node.begin] != quadtree.keys[node.end - 1]) CHECK(node.end - node.begin <= 8);
+        }
+        for (int i = 0; i < (int)boids.size(); i += 7) {
+            std::vector<int> candidates;
+            quadtree.ForEachCandidate(boids[i].position, [&](int j) { candidates.push_back(j); });
+            std::sort(candidates.begin(), candidates.end());
+            REQUIRE(std::adjacent_find(candidates.begin(), candidates.end()) == candidates.end());
+            for (int j = 0; j < (int)boids.size(); j++) {
+                if (boids[i].position.DistanceSquared(boids[j].position) <= 0.25) {
+                    REQUIRE(std::binary_search(candidates.begin(), candidates.end(), j));
+                }
+            }
+        }
+    }
+
+    SUBCASE("Morton keys interleave x in the even bits") {
+        CHECK(LinearQuadtree::MortonKey(0, 0) == 0);
+        CHECK(LinearQuadtree::MortonKey(1, 0) == 1);
+        CHECK(LinearQuadtree::MortonKey(0, 1) == 2);
+        CHECK(LinearQuadtree::MortonKey(0xFFFF, 0) == 0x55555555u);
+        CHECK(LinearQuadtree::MortonKey(0xFFFF, 0xFFFF) == 0xFFFFFFFFu);
+    }
+
+    SUBCASE("Steps match the uniform grid") {
+        for (auto storage : {Flocking::Storage::ArrayOfStructs, Flocking::Storage::StructOfArrays}) {
+            Flocking grid(0.4, 0.1, 2.0, 0.3, 1.0, 0.01, 0.5, boids);
+            Flocking quadtree = grid;
+            grid.storage = quadtree.storage = storage;
+            quadtree.neighborIndex = Flocking::NeighborIndex::Quadtree;
+            for (int step = 0; step < 3; step++) {
+                grid.Step(0.05);
+                quadtree.Step(0.05);
+            }
+            for (size_t i = 0; i < boids.size(); i++) {
+                REQUIRE(isClose(quadtree.GetCurrentState()[i].position, grid.GetCurrentState()[i].position));
+                REQUIRE(isClose(quadtree.GetCurrentState()[i].velocity, grid.GetCurrentState()[i].velocity));
+            }
+        }
+    }
+
+    SUBCASE("Degenerate flocks") {
+        LinearQuadtree quadtree;
+        quadtree.Build(std::vector<Boid>(), 1.0);
+        CHECK(quadtree.nodes.empty());
+        int visited = 0;
+        quadtree.ForEachCandidate(Vector2(0, 0), [&](int) { visited++; });
+        CHECK(visited == 0);
+
+        // every boid on the same spot shares one key, and so one leaf
+        quadtree.Build(std::vector<Boid>(100, Boid(Vector2(3, 4), Vector2(0, 0))), 1.0);
+        REQUIRE(quadtree.nodes.size() == 1);
+        quadtree.ForEachCandidate(Vector2(3.5, 4), [&](int) { visited++; });
+        CHECK(visited == 100);
+    }
+}
+
+TEST_CASE("Verlet neighbor lists") {
+    auto boids = randomFlock(1500, 30, 21);
+
+    SUBCASE("Lists hold every boid within radius plus skin") {
+        VerletLists lists;
+        lists.skin = 0.4;
+        SpatialGrid grid;
+        lists.Build(boids, 1.0, grid, [](int count, const std::function<void(int, int)>& body) { body(0, count); });
+        REQUIRE(lists.start.size() == boids.size() + 1);
+        for (int i = 0; i < (int)boids.size(); i++) {
+            std::vector<int> listed;
+            lists.ForEachCandidate(i, [&](int j) { listed.push_back(j); });
+            std::vector<int> expected;
+            for (int j = 0; j < (int)boids.size(); j++) {
+                if (boids[i].position.DistanceSquared(boids[j].position) <= 1.4 * 1.4) expected.push_back(j);
+            }
+            std::sort(listed.begin(), listed.end());
+            REQUIRE(listed == expected);
+        }
+        CHECK_FALSE(lists.NeedsRebuild(boids, 1.0));
+        CHECK(lists.NeedsRebuild(boids, 1.5));
+
+        auto moved = boids;
+        moved[42].position += Vector2(0.19, 0);
+        CHECK_FALSE(lists.NeedsRebuild(moved, 1.0));
+        moved[42].position += Vector2(0.02, 0);
+        CHECK(lists.NeedsRebuild(moved, 1.0));
+        lists.skin = 0.5;
+        CHECK(lists.NeedsRebuild(boids, 1.0));
+    }
+
+    SUBCASE("Steps match the uniform grid and reuse the lists") {
+        Flocking grid(1.0, 0.5, 2.0, 0.8, 1.0, 0.1, 0.5, boids);
+        Flocking verlet = grid;
+        verlet.neighborIndex = Flocking::NeighborIndex::VerletLists;
+        verlet.GetVerletLists().skin = 0.3;
+        Flocking parallel = verlet;
+        parallel.SetThreads(3);
+        for (int step = 0; step < 40; step++) {
+            grid.Step(0.02);
+            verlet.Step(0.02);
+            parallel.Step(0.02);
+        }
+        for (size_t i = 0; i < boids.size(); i++) {
+            REQUIRE(isClose(verlet.GetCurrentState()[i].position, grid.GetCurrentState()[i].position));
+            REQUIRE(isClose(verlet.GetCurrentState()[i].velocity, grid.GetCurrentState()[i].velocity));
+            REQUIRE(parallel.GetCurrentState()[i].position.x == verlet.GetCurrentState()[i].position.x);
+            REQUIRE(parallel.GetCurrentState()[i].position.y == verlet.GetCurrentState()[i].position.y);
+        }
+
+        const VerletLists& lists = verlet.GetVerletLists();
+        CHECK(lists.steps == 40);
+        CHECK(lists.rebuilds >= 1);
+        CHECK(lists.rebuilds < 40);
+        CHECK(lists.RebuildRate() == doctest::Approx((double)lists.rebuilds / 40));
+        CHECK(lists.HitRate() > 0);
+        CHECK(lists.HitRate() <= 1);
+        CHECK(parallel.GetVerletLists().rebuilds == lists.rebuilds);
+    }
+}
+
+TEST_CASE("Morton reordering") {
+    auto boids = randomFlock(2000, 40, 17);
+
+    SUBCASE("Reordering keeps the input order outside") {
+        Flocking flocking(1.0, 0.5, 2.0, 0.8, 1.0, 0.1, 0.5, boids);
+        flocking.Reorder();
+        const auto& state = flocking.GetCurrentState();
+        REQUIRE(state.size() == boids.size());
+        for (size_t i = 0; i < boids.size(); i++) {
+            REQUIRE(state[i].position.x == boids[i].position.x);
+            REQUIRE(state[i].position.y == boids[i].position.y);
+            REQUIRE(state[i].velocity.x == boids[i].velocity.x);
+        }
+    }
+
+    SUBCASE("Steps match the unordered flock") {
+        for (auto index : {Flocking::NeighborIndex::UniformGrid, Flocking::NeighborIndex::Quadtree, Flocking::NeighborIndex::VerletLists}) {
+            for (auto storage : {Flocking::Storage::ArrayOfStructs, Flocking::Storage::StructOfArrays}) {
+                Flocking plain(1.0, 0.5, 2.0, 0.8, 1.0, 0.1, 0.5, boids);
+                plain.neighborIndex = index;
+                plain.storage = storage;
+                Flocking reordered = plain;
+                reordered.reorderInterval = 3;
+                for (int step = 0; step < 20; step++) {
+                    plain.Step(0.02);
+                    reordered.Step(0.02);
+                }
+                CHECK(reordered.GetStepCount() == 20);
+                for (size_t i = 0; i < boids.size(); i++) {
+                    REQUIRE(isClose(reordered.GetCurrentState()[i].position, plain.GetCurrentState()[i].position));
+                    REQUIRE(isClose(reordered.GetCurrentState()[i].velocity, plain.GetCurrentState()[i].velocity));
+                }
+            }
+        }
+    }
+
+    SUBCASE("Simulator output stays in input order") {
+        for (const auto& [inputFile, outputFile] : findTestFiles()) {
+            std::ifstream inFile(inputFile), outFile(outputFile);
+            std::istringstream input(normalizeLineEndings(std::string((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>())));
+            const std::string expected = normalizeLineEndings(std::string((std::istreambuf_iterator<char>(outFile)), std::istreambuf_iterator<char>()));
+            Simulator simulator(input);
+            simulator.GetFlocking().reorderInterval = 1;
+            std::ostringstream output;
+            simulator.Run(output);
+            INFO("Test case: " << inputFile);
+            CHECK(compareOutputs(output.str(), expected));
+        }
+    }
+}
+
+TEST_CASE("Parameter sweep") {
+    SUBCASE("Metrics of simple flocks") {
+        std::vector<Boid> boids = {Boid({0, 0}, {3, 4}), Boid({3, 0}, {6, 8}), Boid({3, 4}, {0.3, 0.4})};
+        FlockMetrics metrics = FlockMetrics::Measure(boids);
+        CHECK(metrics.meanSpeed == doctest::Approx(15.5 / 3));
+        CHECK(metrics.polarization == doctest::Approx(1));
+        // nearest: 3, 3, 4
+        CHECK(metrics.meanNearestNeighbor == doctest::Approx(10.0 / 3));
+
+        boids[1].velocity = {-3, -4};
+        boids.pop_back();
+        CHECK(FlockMetrics::Measure(boids).polarization == doctest::Approx(0));
+        CHECK(FlockMetrics::Measure({}).meanSpeed == 0);
+    }
+
+    SUBCASE("Nearest neighbors match brute force") {
+        auto boids = randomFlock(800, 50, 4);
+        // a far away straggler, outside the 3x3 cells of everyone
+        boids.push_back(Boid({500, 500}, {0, 0}));
+        double expected = 0;
+        for (size_t i = 0; i < boids.size(); i++) {
+            double nearest = INFINITY;
+            for (size_t j = 0; j < boids.size(); j++) {
+                if (j != i) nearest = std::min(nearest, boids[i].position.Distance(boids[j].position));
+            }
+            expected += nearest;
+        }
+        CHECK(FlockMetrics::Measure(boids).meanNearestNeighbor == doctest::Approx(expected / boids.size()));
+    }
+
+    std::istringstream flock("2 1 1 1 2 2 2 3\n0 0 1 0\n1 0 0 1\n0 1 -1 0\n0.1\n0.1\n");
+    std::istringstream specification("# comment\nsteps 20\ndeltaTime 0.01\ncohesionK 0.5 1 2\n\nseparationRadius 0.5 1.5\n");
+    Sweep sweep = Sweep::Read(specification, flock);
+
+    SUBCASE("Variants are every combination") {
+        CHECK(sweep.steps == 20);
+        CHECK(sweep.deltaTime == 0.01);
+        REQUIRE(sweep.boids.size() == 3);
+        const auto variants = sweep.Variants();
+        REQUIRE(variants.size() == 6);
+        CHECK(variants[0].cohesionK == 0.5);
+        CHECK(variants[0].separationRadius == 0.5);
+        CHECK(variants[1].separationRadius == 1.5);
+        CHECK(variants[5].cohesionK == 2);
+        for (const auto& variant : variants) {
+            CHECK(variant.alignmentK == 2);
+            CHECK(variant.cohesionRadius == 2);
+        }
+    }
+
+    SUBCASE("Runs match sequential simulations") {
+        const auto results = sweep.Run(3);
+        const auto variants = sweep.Variants();
+        REQUIRE(results.size() == variants.size());
+        for (size_t v = 0; v < variants.size(); v++) {
+            Flocking flocking(variants[v], sweep.boids);
+            for (int step = 0; step < sweep.steps; step++) flocking.Step(sweep.deltaTime);
+            const FlockMetrics expected = FlockMetrics::Measure(flocking.GetCurrentState());
+            CHECK(results[v].meanSpeed == expected.meanSpeed);
+            CHECK(results[v].polarization == expected.polarization);
+            CHECK(results[v].meanNearestNeighbor == expected.meanNearestNeighbor);
+        }
+    }
+
+    SUBCASE("Bad specifications are rejected") {
+        for (const char* text : {"cohesionk 1\n", "cohesionK\n", "cohesionK 1 x\n", "steps -1\n"}) {
+            std::istringstream bad(text), base("2 1 1 1 2 2 2 0\n");
+            CHECK_THROWS_AS(Sweep::Read(bad, base), std::invalid_argument);
+        }
+        // missing parameters, a boid short, a boid cut in half, a value that is not a number
+        for (const char* text : {"2 1 1", "2 1 1 1 2 2 2 2\n0 0 1 1\n", "2 1 1 1 2 2 2 1\n0 0 1\n", "2 1 1 1 2 2 2 1\n0 x 1 1\n"}) {
+            std::istringstream spec("steps 1\n"), base(text);
+            CHECK_THROWS_AS(Sweep::Read(spec, base), std::invalid_argument);
+        }
+    }
+}
+
+// steers every boid toward a fixed point, whatever its neighbors
+struct GoalSeeking {
+    Vector2 goal;
+    double k = 1;
+    double radius = 0;
+
+    struct Accumulator {};
+    void Accumulate(Accumulator&, const Vector2&, const Boid&, bool, double) const {}
+    Vector2 Force(const Accumulator&, const Vector2& position) const { return (goal - position).normalized() * k; }
+};
+
+TEST_CASE("Steering behavior packs") {
+    static_assert(std::is_same_v<Flocking, SteeringFlocking<double, Cohesion, Alignment, Separation>>);
+    static_assert(Flocking::Standard && !SteeringFlocking<double, Cohesion, Alignment, Separation, GoalSeeking>::Standard);
+    auto boids = randomFlock(2000, 40, 23);
+    Cohesion cohesion(3.0, 1.2);
+    Alignment alignment(2.0, 0.4);
+    Separation separation(1.0, 1.7, 2.5);
+
+    SUBCASE("The standard pack is the parameter flock") {
+        SteeringFlocking<double, Cohesion, Alignment, Separation> pack(boids, cohesion, alignment, separation);
+        Flocking flocking(3.0, 1.0, 2.5, 2.0, 1.2, 1.7, 0.4, boids);
+        for (int step = 0; step < 10; step++) {
+            pack.Step(0.05);
+            flocking.Step(0.05);
+        }
+        for (size_t i = 0; i < boids.size(); i++) {
+            REQUIRE(pack.GetCurrentState()[i].position.x == flocking.GetCurrentState()[i].position.x);
+            REQUIRE(pack.GetCurrentState()[i].position.y == flocking.GetCurrentState()[i].position.y);
+        }
+    }
+
+    SUBCASE("An added behavior adds its force to the same scan") {
+        GoalSeeking goal{Vector2(-5, 20), 0.7};
+        SteeringFlocking<double, Cohesion, Alignment, Separation, GoalSeeking> pack(boids, cohesion, alignment, separation, goal);
+        Flocking flocking(3.0, 1.0, 2.5, 2.0, 1.2, 1.7, 0.4, boids);
+        CHECK(pack.MaxRadius() == 3.0);
+        SpatialGrid grid;
+        grid.Build(boids, pack.MaxRadius());
+        for (int i = 0; i < (int)boids.size(); i++) {
+            const Vector2 expected = flocking.ComputeForce(boids, i, grid) + goal.Force({}, boids[i].position);
+            const Vector2 force = pack.ComputeForce(boids, i, grid);
+            REQUIRE(force.x == expected.x);
+            REQUIRE(force.y == expected.y);
+        }
+    }
+
+    SUBCASE("Steps match the standard flock on every index and storage") {
+        // a goal of strength 0 adds nothing, so only the summation order differs
+        for (auto index : {Flocking::NeighborIndex::UniformGrid, Flocking::NeighborIndex::Quadtree, Flocking::NeighborIndex::VerletLists}) {
+            for (auto storage : {Flocking::Storage::ArrayOfStructs, Flocking::Storage::StructOfArrays}) {
+                SteeringFlocking<double, Cohesion, Alignment, Separation, GoalSeeking> pack(boids, cohesion, alignment, separation, GoalSeeking{Vector2(0, 0), 0});
+                Flocking flocking(3.0, 1.0, 2.5, 2.0, 1.2, 1.7, 0.4, boids);
+                pack.neighborIndex = static_cast<decltype(pack.neighborIndex)>(index);
+                pack.storage = static_cast<decltype(pack.storage)>(storage);
+                pack.reorderInterval = 4;
+                flocking.neighborIndex = index;
+                flocking.storage = storage;
+                for (int step = 0; step < 10; step++) {
+                    pack.Step(0.02);
+                    flocking.Step(0.02);
+                }
+                for (size_t i = 0; i < boids.size(); i++) {
+                    REQUIRE(isClose(pack.GetCurrentState()[i].position, flocking.GetCurrentState()[i].position));
+                    REQUIRE(isClose(pack.GetCurrentState()[i].velocity, flocking.GetCurrentState()[i].velocity));
+                }
+            }
+        }
+    }
+
+    SUBCASE("A single behavior, tuned between steps") {
+        SteeringFlocking<double, GoalSeeking> pack(boids, GoalSeeking{Vector2(20, 20), 1});
+        CHECK(pack.MaxRadius() == 0.0);
+        pack.GetBehavior<GoalSeeking>().k = 2;
+        pack.Step(0.1);
+        for (size_t i = 0; i < boids.size(); i++) {
+            const Vector2 force = (Vector2(20, 20) - boids[i].position).normalized() * 2.0;
+            REQUIRE(isClose(pack.GetCurrentState()[i].velocity, boids[i].velocity + force * 0.1));
+        }
+        CHECK(pack.GetBehavior<0>().k == 2);
+    }
+}
+
+TEST_CASE("Checkpoints") {
+    auto boids = randomFlock(1500, 30, 31);
+    const std::string path = (fs::temp_directory_path() / "flocking-checkpoint-test.bin").string();
+
+    SUBCASE("A restored flock steps on exactly") {
+        Flocking flocking(1.0, 0.5, 2.0, 0.8, 1.0, 0.1, 0.5, boids);
+        // reordered, so the ids are saved too
+        flocking.reorderInterval = 3;
+        for (int step = 0; step < 7; step++) flocking.Step(0.05);
+        flocking.SaveCheckpoint(path);
+        CHECK(!fs::exists(path + ".tmp"));
+        CHECK(fs::file_size(path) == Checkpoint::HeaderSize + boids.size() * (4 * sizeof(double) + 4));
+
+        Flocking restored = Flocking::LoadCheckpoint(path);
+        restored.reorderInterval = 3;
+        CHECK(restored.GetStepCount() == 7);
+        const FlockingParameters parameters = restored.GetParameters();
+        CHECK(parameters.cohesionRadius == 1.0);
+        CHECK(parameters.separationMaxForce == 2.0);
+        CHECK(parameters.alignmentK == 0.5);
+        for (int step = 0; step < 10; step++) {
+            flocking.Step(0.05);
+            restored.Step(0.05);
+        }
+        for (size_t i = 0; i < boids.size(); i++) {
+            REQUIRE(restored.GetCurrentState()[i].position.x == flocking.GetCurrentState()[i].position.x);
+            REQUIRE(restored.GetCurrentState()[i].position.y == flocking.GetCurrentState()[i].position.y);
+            REQUIRE(restored.GetCurrentState()[i].velocity.x == flocking.GetCurrentState()[i].velocity.x);
+            REQUIRE(restored.GetCurrentState()[i].velocity.y == flocking.GetCurrentState()[i].velocity.y);
+        }
+    }
+
+    SUBCASE("Float flocks keep their precision and are not read as double") {
+        std::vector<BasicBoid<float>> floats;
+        for (const Boid& boid : boids) floats.emplace_back(BasicVector2<float>((float)boid.position.x, (float)boid.position.y), BasicVector2<float>((float)boid.velocity.x, (float)boid.velocity.y));
+        BasicFlocking<float> single(1.0f, 0.5f, 2.0f, 0.8f, 1.0f, 0.1f, 0.5f, floats);
+        single.Step(0.05f);
+        single.SaveCheckpoint(path);
+        CHECK(fs::file_size(path) == Checkpoint::HeaderSize + boids.size() * 4 * sizeof(float));
+        BasicFlocking<float> restored = BasicFlocking<float>::LoadCheckpoint(path);
+        for (size_t i = 0; i < boids.size(); i++) {
+            REQUIRE(restored.GetCurrentState()[i].position.x == single.GetCurrentState()[i].position.x);
+            REQUIRE(restored.GetCurrentState()[i].velocity.y == single.GetCurrentState()[i].velocity.y);
+        }
+        CHECK_THROWS_AS(Flocking::LoadCheckpoint(path), std::runtime_error);
+    }
+
+    SUBCASE("Damaged files are rejected") {
+        Flocking flocking(1.0, 0.5, 2.0, 0.8, 1.0, 0.1, 0.5, boids);
+        flocking.Reorder();
+        std::ostringstream out;
+        flocking.SaveCheckpoint(out);
+        const std::string bytes = out.str();
+        auto load = [&](const std::string& content) {
+            std::ofstream(path, std::ios::binary) << content;
+            return Flocking::LoadCheckpoint(path);
+        };
+        CHECK(load(bytes).GetCurrentState().size() == boids.size());
+        CHECK_THROWS_AS(load(""), std::runtime_error);
+        CHECK_THROWS_AS(load("FLCK"), std::runtime_error);
+        CHECK_THROWS_AS(load("XXXX" + bytes.substr(4)), std::runtime_error);
+        CHECK_THROWS_AS(load(bytes.substr(0, bytes.size() - 1)), std::runtime_error);
+        CHECK_THROWS_AS(load(bytes + "x"), std::runtime_error);
+        // boid 0 listed twice
+        std::string twice = bytes;
+        std::memcpy(&twice[twice.size() - 4], &twice[twice.size() - 8], 4);
+        CHECK_THROWS_AS(load(twice), std::runtime_error);
+        CHECK_THROWS_AS(Flocking::LoadCheckpoint(path + ".missing"), std::runtime_error);
+    }
+
+    SUBCASE("A simulator resumes from its last checkpoint") {
+        std::ostringstream head;
+        head << "1 0.5 2 0.8 1 0.1 0.5\n" << boids.size() << "\n" << std::setprecision(17);
+        for (const Boid& boid : boids) head << boid.position.x << " " << boid.position.y << " " << boid.velocity.x << " " << boid.velocity.y << "\n";
+        const std::string firstSteps = "0.05\n0.05\n0.04\n0.05\n0.03\n0.05\n", lastSteps = "0.02\n0.05\n0.05\n";
+
+        std::istringstream whole(head.str() + firstSteps + lastSteps);
+        Simulator uninterrupted(whole);
+        std::ostringstream expected;
+        uninterrupted.Run(expected);
+
+        // a run that stops after 6 steps, with a checkpoint every 4: the last one holds step 4
+        std::istringstream interrupted(head.str() + firstSteps);
+        Simulator crashed(interrupted);
+        crashed.SetCheckpoints(path, 4);
+        std::ostringstream before;
+        crashed.Run(before);
+        std::istringstream replay("0.03\n0.05\n" + lastSteps);
+        Simulator resumed(path, replay);
+        CHECK(resumed.GetFlocking().GetStepCount() == 4);
+        std::ostringstream after;
+        resumed.Run(after);
+
+        // frames 1 to 4 from the first run, 5 to 9 from the resumed one
+        std::istringstream beforeLines(before.str());
+        std::string frames, line;
+        const size_t linesPerFrame = boids.size();
+        for (size_t k = 0; k < 4 * linesPerFrame && std::getline(beforeLines, line); k++) frames += line + "\n";
+        CHECK(frames + after.str() == expected.str());
+
+        // writing every 3rd frame with a checkpoint at step 5: both runs write steps 3, 6 and 9
+        std::istringstream wholeAgain(head.str() + firstSteps + lastSteps);
+        Simulator decimated(wholeAgain);
+        std::ostringstream expectedEvery3;
+        decimated.Run(expectedEvery3, 3);
+        std::istringstream interruptedAgain(head.str() + firstSteps);
+        Simulator crashedAgain(interruptedAgain);
+        crashedAgain.SetCheckpoints(path, 5);
+        std::ostringstream beforeEvery3;
+        crashedAgain.Run(beforeEvery3, 3);
+        std::istringstream replayFrom5("0.05\n" + lastSteps);
+        Simulator resumedAt5(path, replayFrom5);
+        CHECK(resumedAt5.GetFlocking().GetStepCount() == 5);
+        std::ostringstream afterEvery3;
+        resumedAt5.Run(afterEvery3, 3);
+        // the frame of step 3 comes from the first run, the ones of steps 6 and 9 from the resumed one
+        const std::string resumedFrames = afterEvery3.str();
+        CHECK(std::count(resumedFrames.begin(), resumedFrames.end(), '\n') == (long)(2 * linesPerFrame));
+        std::istringstream firstRunLines(beforeEvery3.str());
+        std::string step3;
+        for (size_t k = 0; k < linesPerFrame && std::getline(firstRunLines, line); k++) step3 += line + "\n";
+        CHECK(step3 + resumedFrames == expectedEvery3.str());
+    }
+
+    fs::remove(path);
+}
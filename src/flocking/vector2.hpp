@@ -1,78 +1,84 @@
+#pragma once
 #include <cmath>
 
-struct Vector2 {
-  double x=0, y=0;
-  Vector2() : x(0), y(0){};
-  Vector2(double x, double y) : x(x), y(y){};
-  Vector2(const Vector2& v) = default;
+// 2D vector over a scalar type T. Vector2 is the double version used everywhere by default
+template <typename T>
+struct BasicVector2 {
+  using Scalar = T;
+  T x=0, y=0;
+  BasicVector2() : x(0), y(0){};
+  BasicVector2(T x, T y) : x(x), y(y){};
+  BasicVector2(const BasicVector2& v) = default;
 
   // unary operations
-  Vector2 operator-() const { return {-x, -y}; }
-  Vector2 operator+() const { return {x, y}; }
+  BasicVector2 operator-() const { return {-x, -y}; }
+  BasicVector2 operator+() const { return {x, y}; }
 
   // binary operations
-  Vector2 operator-(const Vector2& rhs) const { return {x - rhs.x, y - rhs.y}; }
-  Vector2 operator+(const Vector2& rhs) const { return {x + rhs.x, y + rhs.y}; }
-  Vector2 operator*(const double& rhs) const { return {x * rhs, y * rhs}; }
-  friend Vector2 operator*(const double& lhs, const Vector2& rhs) { return {lhs * rhs.x, lhs * rhs.y}; }
-  Vector2 operator/(const double& rhs) const { return {x / rhs, y / rhs}; }
-  Vector2 operator/(const Vector2& rhs) const { return {x / rhs.x, y / rhs.y}; }
-  bool operator!=(const Vector2& rhs) const { return (*this - rhs).sqrMagnitude() >= 1.0e-6; };
-  bool operator==(const Vector2& rhs) const { return (*this - rhs).sqrMagnitude() < 1.0e-6; };
+  BasicVector2 operator-(const BasicVector2& rhs) const { return {x - rhs.x, y - rhs.y}; }
+  BasicVector2 operator+(const BasicVector2& rhs) const { return {x + rhs.x, y + rhs.y}; }
+  BasicVector2 operator*(const T& rhs) const { return {x * rhs, y * rhs}; }
+  friend BasicVector2 operator*(const T& lhs, const BasicVector2& rhs) { return {lhs * rhs.x, lhs * rhs.y}; }
+  BasicVector2 operator/(const T& rhs) const { return {x / rhs, y / rhs}; }
+  BasicVector2 operator/(const BasicVector2& rhs) const { return {x / rhs.x, y / rhs.y}; }
+  bool operator!=(const BasicVector2& rhs) const { return (*this - rhs).sqrMagnitude() >= T(1.0e-6); };
+  bool operator==(const BasicVector2& rhs) const { return (*this - rhs).sqrMagnitude() < T(1.0e-6); };
 
   // assignment operation
-  Vector2& operator=(Vector2 const& rhs) = default;
-  Vector2& operator=(Vector2&& rhs) = default;
+  BasicVector2& operator=(BasicVector2 const& rhs) = default;
+  BasicVector2& operator=(BasicVector2&& rhs) = default;
 
   // compound assignment operations
-  Vector2& operator+=(const Vector2& rhs) {
+  BasicVector2& operator+=(const BasicVector2& rhs) {
     x += rhs.x;
     y += rhs.y;
     return *this;
   }
-  Vector2& operator-=(const Vector2& rhs) {
+  BasicVector2& operator-=(const BasicVector2& rhs) {
     x -= rhs.x;
     y -= rhs.y;
     return *this;
   }
-  Vector2& operator*=(const double& rhs) {
+  BasicVector2& operator*=(const T& rhs) {
     x *= rhs;
     y *= rhs;
     return *this;
   }
-  Vector2& operator/=(const double& rhs) {
+  BasicVector2& operator/=(const T& rhs) {
     x /= rhs;
     y /= rhs;
     return *this;
   }
-  Vector2& operator*=(const Vector2& rhs) {
+  BasicVector2& operator*=(const BasicVector2& rhs) {
     x *= rhs.x;
     y *= rhs.y;
     return *this;
   }
-  Vector2& operator/=(const Vector2& rhs) {
+  BasicVector2& operator/=(const BasicVector2& rhs) {
     x /= rhs.x;
     y /= rhs.y;
     return *this;
   }
 
-  double sqrMagnitude() const { return x * x + y * y; }
-  double getMagnitude() const { return sqrt(sqrMagnitude()); }
-  static double getMagnitude(const Vector2& vector) { return vector.getMagnitude(); }
+  T sqrMagnitude() const { return x * x + y * y; }
+  T getMagnitude() const { return std::sqrt(sqrMagnitude()); }
+  static T getMagnitude(const BasicVector2& vector) { return vector.getMagnitude(); }
 
-  static double Distance(const Vector2& a, const Vector2& b) { return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y)); };
-  double Distance(const Vector2& b) const { return sqrt((x - b.x) * (x - b.x) + (y - b.y) * (y - b.y)); };
-  static double DistanceSquared(const Vector2& a, const Vector2& b) { return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y); };
-  double DistanceSquared(const Vector2& b) const { return (x - b.x) * (x - b.x) + (y - b.y) * (y - b.y); };
+  static T Distance(const BasicVector2& a, const BasicVector2& b) { return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y)); };
+  T Distance(const BasicVector2& b) const { return std::sqrt((x - b.x) * (x - b.x) + (y - b.y) * (y - b.y)); };
+  static T DistanceSquared(const BasicVector2& a, const BasicVector2& b) { return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y); };
+  T DistanceSquared(const BasicVector2& b) const { return (x - b.x) * (x - b.x) + (y - b.y) * (y - b.y); };
 
-  static Vector2 normalized(const Vector2& v) { return v.normalized(); };
-  Vector2 normalized() const {
+  static BasicVector2 normalized(const BasicVector2& v) { return v.normalized(); };
+  BasicVector2 normalized() const {
     auto magnitude = getMagnitude();
 
     // If the magnitude is not null
-    if (magnitude > 0.)
-      return Vector2(x, y) / magnitude;
+    if (magnitude > T(0))
+      return BasicVector2(x, y) / magnitude;
     else
       return {x, y};
   };
-};
\ No newline at end of file
+};
+
+using Vector2 = BasicVector2<double>;
@@ -0,0 +1,99 @@
+#pragma once
+#include "spatialgrid.hpp"
+#include "vector2.hpp"
+#include <functional>
+#include <vector>
+
+/**
+ * Per boid neighbor lists kept across steps (Verlet lists), for flocks that move little per step.
+ *
+ * Build() lists, for every boid, the boids within radius + skin, itself included, in one flat array: the
+ * neighbors of boid i are neighbors[start[i]] .. neighbors[start[i + 1] - 1]. Until some boid has moved more
+ * than skin / 2 from where it was at the last build, no pair can have closed the skin, so every boid within
+ * the radius is still in the list and the lists can be reused as they are. NeedsRebuild() checks that.
+ *
+ * A wider skin rebuilds less often but lists more boids out of reach. The counters show both sides: the
+ * rebuild rate is rebuilds per step, the hit rate the share of listed pairs that were within the radius.
+ */
+struct VerletLists {
+  // in the units of the radii. changing it forces a rebuild
+  double skin = 0.5;
+
+  std::vector<int> start;
+  std::vector<int> neighbors;
+
+  // since the last ResetCounters. Flocking counts steps, rebuilds, listed pairs scanned and pairs in reach
+  long long steps = 0, rebuilds = 0, candidates = 0, hits = 0;
+
+  double RebuildRate() const { return steps > 0 ? (double)rebuilds / steps : 0.0; }
+  double HitRate() const { return candidates > 0 ? (double)hits / candidates : 0.0; }
+  void ResetCounters() { steps = rebuilds = candidates = hits = 0; }
+
+  // for when the boids were renumbered: the next NeedsRebuild is true
+  void Invalidate() { start.clear(); }
+
+  template <typename Agents>
+  bool NeedsRebuild(const Agents& agents, double radius) const {
+    if (start.size() != agents.size() + 1 || radius != builtRadius || skin != builtSkin) return true;
+    const double limit = skin * skin / 4;
+    for (size_t i = 0; i < agents.size(); i++) {
+      const Vector2 position((double)agents[i].position.x, (double)agents[i].position.y);
+      // also true for NaN, a diverged boid never keeps stale lists
+      if (!(position.DistanceSquared(reference[i]) <= limit)) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Rebuilds the lists from the candidates of grid, which is rebuilt for radius + skin. run(count, body) calls
+   * body(begin, end) over [0, count), possibly in parallel: the counting and the filling passes only write the
+   * entries of the boids in their range.
+   */
+  template <typename Agents>
+  void Build(const Agents& agents, double radius, SpatialGrid& grid, const std::function<void(int, const std::function<void(int, int)>&)>& run) {
+    const int count = (int)agents.size();
+    const double reach = radius + skin, reachSquared = reach * reach;
+    grid.Build(agents, reach);
+    start.assign(count + 1, 0);
+
+    // start[i + 1] counts the list of boid i first, the prefix sum then turns the counts into offsets
+    auto forEachInReach = [&](int i, auto&& visit) {
+      const Vector2 position((double)agents[i].position.x, (double)agents[i].position.y);
+      grid.ForEachCandidate(position, [&](int j) {
+        const Vector2 other((double)agents[j].position.x, (double)agents[j].position.y);
+        if (position.DistanceSquared(other) <= reachSquared) visit(j);
+      });
+    };
+    run(count, [&](int begin, int end) {
+      for (int k = begin; k < end; k++) {
+        const int i = grid.indices[k];
+        forEachInReach(i, [&](int) { start[i + 1]++; });
+      }
+    });
+    for (int i = 0; i < count; i++) start[i + 1] += start[i];
+    neighbors.resize(start[count]);
+    run(count, [&](int begin, int end) {
+      for (int k = begin; k < end; k++) {
+        const int i = grid.indices[k];
+        int slot = start[i];
+        forEachInReach(i, [&](int j) { neighbors[slot++] = j; });
+      }
+    });
+
+    reference.resize(count);
+    for (int i = 0; i < count; i++) reference[i] = Vector2((double)agents[i].position.x, (double)agents[i].position.y);
+    builtRadius = radius;
+    builtSkin = skin;
+    rebuilds++;
+  }
+
+  // calls visit(index) for every boid in the list of boid i. the caller filters by distance
+  template <typename Visit>
+  void ForEachCandidate(int i, Visit&& visit) const {
+    for (int k = start[i]; k < start[i + 1]; k++) visit(neighbors[k]);
+  }
+
+private:
+  std::vector<Vector2> reference;
+  double builtRadius = 0, builtSkin = 0;
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of threads running parallel loops, with work stealing between them.
+ *
+ * ParallelFor cuts [0, count) in chunks and deals every thread a contiguous run of them. A thread takes its
+ * own chunks from the front, in order, and once it runs out it steals from the back of the other threads'
+ * runs, so a thread stuck in a dense part of the flock is helped by the ones that finished early. The
+ * calling thread works too, so a pool of n threads starts n - 1 of them.
+ *
+ * Which thread runs a chunk changes between runs, so the body must only write to data owned by its range.
+ * Nothing is allocated while a loop runs.
+ */
+struct WorkStealingPool {
+  explicit WorkStealingPool(int threads = 0) {
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < threads; i++) runs.push_back(std::make_unique<Run>());
+    for (int i = 1; i < threads; i++) workers.emplace_back([this, i] { Work(i); });
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  int ThreadCount() const { return (int)runs.size(); }
+
+  // calls body(begin, end) over [0, count) in chunks of at most chunkSize, and returns when all are done
+  void ParallelFor(int count, int chunkSize, const std::function<void(int, int)>& body) {
+    if (count <= 0) return;
+    // one loop at a time, in case several callers share the pool
+    std::lock_guard<std::mutex> serial(submit);
+
+    chunkSize = std::max(chunkSize, 1);
+    const int chunks = (count + chunkSize - 1) / chunkSize;
+    const int threads = ThreadCount();
+    for (int t = 0; t < threads; t++) {
+      Run& run = *runs[t];
+      std::lock_guard<std::mutex> lock(run.mutex);
+      run.front = (int)((long long)chunks * t / threads);
+      run.back = (int)((long long)chunks * (t + 1) / threads);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &body;
+      jobCount = count;
+      jobChunkSize = chunkSize;
+      busy = threads - 1;
+      error = nullptr;
+      generation++;
+    }
+    wake.notify_all();
+
+    RunChunks(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+    if (error) std::rethrow_exception(error);
+  }
+
+private:
+  // the chunks [front, back) still waiting in one thread's share
+  struct Run {
+    std::mutex mutex;
+    int front = 0, back = 0;
+  };
+
+  std::vector<std::unique_ptr<Run>> runs;
+
+  std::mutex submit;
+  std::mutex mutex;
+  std::condition_variable wake, done;
+  const std::function<void(int, int)>* job = nullptr;
+  int jobCount = 0, jobChunkSize = 1;
+  int busy = 0;
+  unsigned long long generation = 0;
+  bool stopping = false;
+  std::exception_ptr error;
+  // last, so the threads are joined before the state they use is destroyed
+  std::vector<std::jthread> workers;
+
+  void Work(int self) {
+    unsigned long long seen = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+      }
+      RunChunks(self);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--busy == 0) done.notify_one();
+    }
+  }
+
+  void RunChunks(int self) {
+    const int threads = ThreadCount();
+    int chunk;
+    while (TakeFront(*runs[self], chunk) || Steal(self, threads, chunk)) {
+      const int begin = chunk * jobChunkSize, end = std::min(begin + jobChunkSize, jobCount);
+      try {
+        (*job)(begin, end);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+      }
+    }
+  }
+
+  static bool TakeFront(Run& run, int& chunk) {
+    std::lock_guard<std::mutex> lock(run.mutex);
+    if (run.front == run.back) return false;
+    chunk = run.front++;
+    return true;
+  }
+
+  // no chunk is ever added during a loop, so finding every run empty once means this thread is done
+  bool Steal(int self, int threads, int& chunk) {
+    for (int i = 1; i < threads; i++) {
+      Run& victim = *runs[(self + i) % threads];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.front != victim.back) {
+        chunk = --victim.back;
+        return true;
+      }
+    }
+    return false;
+  }
+};
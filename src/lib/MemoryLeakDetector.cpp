@@ -1,7 +1,9 @@
 #include "MemoryLeakDetector.h"
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <mutex>
 
 // Dynamic allocation tracking to avoid overflow issues
 static allocation_tracker* allocations = nullptr;
@@ -9,6 +11,21 @@ static size_t total_allocated = 0;
 static size_t current_usage = 0;
 static size_t peak_usage = 0;
 static bool initialized = false;
+// operator new and delete can run on any thread, the table and counters are only touched under this lock
+static std::mutex tracker_mutex;
+
+// The tracker is an open addressing hash table keyed by pointer, so freeing stays O(1) even with
+// millions of live allocations. Freed slots are marked with a tombstone to keep probe chains intact.
+static void* const TOMBSTONE = reinterpret_cast<void*>(1);
+static size_t tombstones = 0;
+
+static bool is_live(void* ptr) { return ptr != nullptr && ptr != TOMBSTONE; }
+
+static std::size_t slot_of(void* ptr, std::size_t capacity) {
+  std::uint64_t h = reinterpret_cast<std::uintptr_t>(ptr) >> 4;
+  h *= 0x9E3779B97F4A7C15ull;
+  return static_cast<std::size_t>(h ^ (h >> 29)) & (capacity - 1);
+}
 
 static void cleanup_and_report() {
   if (!initialized || !allocations)
@@ -21,8 +38,9 @@ static void cleanup_and_report() {
 
   if (allocations->count > 0) {
     fprintf(stderr, "\n=== Memory Leaks Detected ===\n");
-    for (std::size_t i = 0; i < allocations->count; ++i) {
-      fprintf(stderr, "LEAK: %zu bytes at address %p\n", allocations->sizes[i], allocations->ptrs[i]);
+    for (std::size_t i = 0; i < allocations->capacity; ++i) {
+      if (is_live(allocations->ptrs[i]))
+        fprintf(stderr, "LEAK: %zu bytes at address %p\n", allocations->sizes[i], allocations->ptrs[i]);
     }
     fprintf(stderr, "Total leaked: %zu bytes in %zu allocation(s)\n",
             current_usage, allocations->count);
@@ -39,6 +57,7 @@ static void cleanup_and_report() {
 }
 
 static void ensure_initialized() {
+  std::lock_guard<std::mutex> lock(tracker_mutex);
   if (!initialized) {
     // Use malloc to avoid circular dependency
     allocations = (allocation_tracker*)std::malloc(sizeof(allocation_tracker));
@@ -54,29 +73,57 @@ static void ensure_initialized() {
   }
 }
 
+static bool rehash(std::size_t new_capacity) {
+  void** new_ptrs = (void**)std::calloc(new_capacity, sizeof(void*));
+  std::size_t* new_sizes = (std::size_t*)std::malloc(new_capacity * sizeof(std::size_t));
+  if (!new_ptrs || !new_sizes) {
+    std::free(new_ptrs);
+    std::free(new_sizes);
+    return false;
+  }
+
+  for (std::size_t i = 0; i < allocations->capacity; ++i) {
+    if (!is_live(allocations->ptrs[i]))
+      continue;
+    std::size_t slot = slot_of(allocations->ptrs[i], new_capacity);
+    while (new_ptrs[slot])
+      slot = (slot + 1) & (new_capacity - 1);
+    new_ptrs[slot] = allocations->ptrs[i];
+    new_sizes[slot] = allocations->sizes[i];
+  }
+
+  std::free(allocations->ptrs);
+  std::free(allocations->sizes);
+  allocations->ptrs = new_ptrs;
+  allocations->sizes = new_sizes;
+  allocations->capacity = new_capacity;
+  tombstones = 0;
+  return true;
+}
+
 static void track_allocation(void *ptr, size_t size) {
+  std::lock_guard<std::mutex> lock(tracker_mutex);
   if (!ptr || !allocations)
     return;
 
-  // Grow arrays if needed
-  if (allocations->count >= allocations->capacity) {
-    std::size_t new_capacity = (allocations->capacity == 0) ? 100 : allocations->capacity * 2;
-    
-    void** new_ptrs = (void**)std::realloc(allocations->ptrs, new_capacity * sizeof(void*));
-    std::size_t* new_sizes = (std::size_t*)std::realloc(allocations->sizes, new_capacity * sizeof(std::size_t));
-    
-    if (!new_ptrs || !new_sizes) {
+  // Keep the table at most half full, counting tombstones
+  if ((allocations->count + tombstones + 1) * 2 > allocations->capacity) {
+    std::size_t new_capacity = 128;
+    while (new_capacity < (allocations->count + 1) * 4)
+      new_capacity *= 2;
+    if (!rehash(new_capacity)) {
       // Allocation failed, can't track this allocation
       return;
     }
-    
-    allocations->ptrs = new_ptrs;
-    allocations->sizes = new_sizes;
-    allocations->capacity = new_capacity;
   }
-  
-  allocations->ptrs[allocations->count] = ptr;
-  allocations->sizes[allocations->count] = size;
+
+  std::size_t slot = slot_of(ptr, allocations->capacity);
+  while (is_live(allocations->ptrs[slot]))
+    slot = (slot + 1) & (allocations->capacity - 1);
+  if (allocations->ptrs[slot] == TOMBSTONE)
+    tombstones--;
+  allocations->ptrs[slot] = ptr;
+  allocations->sizes[slot] = size;
   allocations->count++;
 
   total_allocated += size;
@@ -87,18 +134,18 @@ static void track_allocation(void *ptr, size_t size) {
 }
 
 static void untrack_allocation(void *ptr) {
-  if (!ptr || !allocations)
+  std::lock_guard<std::mutex> lock(tracker_mutex);
+  if (!ptr || !allocations || allocations->capacity == 0)
     return;
 
-  for (std::size_t i = 0; i < allocations->count; ++i) {
-    if (allocations->ptrs[i] == ptr) {
-      std::size_t size = allocations->sizes[i];
-      
-      // Move last element to this position
-      allocations->ptrs[i] = allocations->ptrs[allocations->count - 1];
-      allocations->sizes[i] = allocations->sizes[allocations->count - 1];
+  for (std::size_t slot = slot_of(ptr, allocations->capacity); allocations->ptrs[slot];
+       slot = (slot + 1) & (allocations->capacity - 1)) {
+    if (allocations->ptrs[slot] == ptr) {
+      std::size_t size = allocations->sizes[slot];
+      allocations->ptrs[slot] = TOMBSTONE;
       allocations->count--;
-      
+      tombstones++;
+
       if (current_usage >= size) {
         current_usage -= size;
       } else {
@@ -115,9 +162,19 @@ track_type *get_map() {
   return &dummy;
 }
 
+// Snapshot of the counters kept by the tracker
 memory_stats *get_stats() {
-  static memory_stats dummy;
-  return &dummy;
+  static memory_stats stats;
+  std::lock_guard<std::mutex> lock(tracker_mutex);
+  stats.total_allocated = total_allocated;
+  stats.current_usage = current_usage;
+  stats.peak_usage = peak_usage;
+  return &stats;
+}
+
+void reset_peak_usage() {
+  std::lock_guard<std::mutex> lock(tracker_mutex);
+  peak_usage = current_usage;
 }
 
 void *operator new(std::size_t size) noexcept(false) {
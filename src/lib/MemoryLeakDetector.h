@@ -31,7 +31,8 @@ typedef std::map<void *, std::size_t, std::less<void *>,
                  track_alloc<std::pair<void *const, std::size_t>>>
     track_type;
 
-// Dynamic allocation tracking using C-style arrays to avoid STL circular dependencies
+// Dynamic allocation tracking using C-style arrays to avoid STL circular dependencies.
+// ptrs and sizes form an open addressing hash table of capacity slots, count of them live
 struct allocation_tracker {
     void** ptrs;
     std::size_t* sizes;
@@ -63,6 +64,8 @@ struct memory_stats {
 
 track_type *get_map();
 memory_stats *get_stats();
+// starts measuring the peak again from the current usage
+void reset_peak_usage();
 void print_memory_report();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+// Throughput benchmark for the maze module: generation, printing and path queries.
+// usage: maze-bench [size...]   sizes are the side of square mazes, default 100 1000 5000 10000 20000
+// results are written to stdout as JSON, the memory report goes to stderr
+#include "MemoryLeakDetector.h"
+#include "maze.hpp"
+#include "hpa.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Result
+{
+    size_t size = 0;
+    double generateCellsPerSecond = 0;
+    double printBytesPerSecond = 0;
+    double hpaBuildSeconds = 0;
+    double pathQueriesPerSecond = 0;
+    double bfsQueriesPerSecond = 0;
+    size_t peakMemory = 0;
+};
+
+/* Breadth first search over the whole maze, the baseline for the HPA queries. A perfect maze has a single
+ * path between two cells, so both find the same one. Buffers are kept between queries.
+ */
+struct BreadthFirstSearch
+{
+    static constexpr uint32_t Unvisited = UINT32_MAX;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> queue;
+
+    std::vector<std::pair<size_t, size_t>> findPath(const Maze &maze, std::pair<size_t, size_t> start, std::pair<size_t, size_t> goal)
+    {
+        const size_t width = maze.width, height = maze.height;
+        const uint32_t startCell = static_cast<uint32_t>(start.second * width + start.first);
+        const uint32_t goalCell = static_cast<uint32_t>(goal.second * width + goal.first);
+        parent.assign(width * height, Unvisited);
+        queue.clear();
+        parent[startCell] = startCell;
+        queue.push_back(startCell);
+        for (size_t head = 0; head < queue.size() && parent[goalCell] == Unvisited; ++head)
+        {
+            const uint32_t cell = queue[head];
+            const size_t x = cell % width, y = cell / width;
+            for (uint8_t d = 0; d < 4; ++d)
+            {
+                const auto dir = static_cast<Direction>(d);
+                if (!Maze::isInside(x, y, dir, width, height) || !maze.isOpen(x, y, dir))
+                    continue;
+                const auto [nx, ny] = Maze::step(x, y, dir);
+                const uint32_t next = static_cast<uint32_t>(ny * width + nx);
+                if (parent[next] != Unvisited)
+                    continue;
+                parent[next] = cell;
+                queue.push_back(next);
+            }
+        }
+        std::vector<std::pair<size_t, size_t>> path;
+        if (parent[goalCell] == Unvisited)
+            return path;
+        for (uint32_t cell = goalCell; cell != startCell; cell = parent[cell])
+            path.emplace_back(cell % width, cell / width);
+        path.emplace_back(start);
+        return {path.rbegin(), path.rend()};
+    }
+};
+
+// repeats small workloads until they take long enough to be measured, big ones run once
+static constexpr double MinimumSeconds = 0.5;
+
+static Result run(size_t size)
+{
+    Result result;
+    result.size = size;
+    reset_peak_usage();
+
+    Maze maze(size, size, 0);
+    size_t repetitions = 0;
+    auto start = Clock::now();
+    do
+    {
+        maze.generate();
+        ++repetitions;
+    } while (secondsSince(start) < MinimumSeconds);
+    result.generateCellsPerSecond = double(size) * size * repetitions / secondsSince(start);
+
+    size_t bytes = 0;
+    start = Clock::now();
+    do
+    {
+        bytes += maze.print().size();
+    } while (secondsSince(start) < MinimumSeconds);
+    result.printBytesPerSecond = bytes / secondsSince(start);
+
+    start = Clock::now();
+    HPACache cache(maze);
+    result.hpaBuildSeconds = secondsSince(start);
+
+    // fixed sequence of queries so every run, and both searches, ask the same thing
+    uint64_t state;
+    auto nextCoordinate = [&]()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<size_t>(state % size);
+    };
+    auto queriesPerSecond = [&](auto &&findPath)
+    {
+        state = 88172645463325252ull;
+        size_t queries = 0;
+        auto start = Clock::now();
+        do
+        {
+            size_t sx = nextCoordinate(), sy = nextCoordinate(), gx = nextCoordinate(), gy = nextCoordinate();
+            if (findPath(std::pair{sx, sy}, std::pair{gx, gy}).empty())
+            {
+                std::cerr << "no path found between (" << sx << ", " << sy << ") and (" << gx << ", " << gy << ")" << std::endl;
+                std::exit(1);
+            }
+            ++queries;
+        } while (secondsSince(start) < MinimumSeconds && queries < 10000);
+        return queries / secondsSince(start);
+    };
+    result.pathQueriesPerSecond = queriesPerSecond([&](auto from, auto to) { return cache.findPath(maze, from, to); });
+    BreadthFirstSearch bfs;
+    result.bfsQueriesPerSecond = queriesPerSecond([&](auto from, auto to) { return bfs.findPath(maze, from, to); });
+
+    result.peakMemory = get_stats()->peak_usage;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::stoul(argv[i]));
+    if (sizes.empty())
+        sizes = {100, 1000, 5000, 10000, 20000};
+
+    std::cout << "{\n  \"benchmark\": \"maze\",\n  \"results\": [\n";
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        std::cerr << "running " << sizes[i] << "x" << sizes[i] << "..." << std::endl;
+        Result r = run(sizes[i]);
+        std::cout << "    {\"width\": " << r.size << ", \"height\": " << r.size
+                  << ", \"generate_cells_per_second\": " << r.generateCellsPerSecond
+                  << ", \"print_bytes_per_second\": " << r.printBytesPerSecond
+                  << ", \"hpa_build_seconds\": " << r.hpaBuildSeconds
+                  << ", \"path_queries_per_second\": " << r.pathQueriesPerSecond
+                  << ", \"bfs_queries_per_second\": " << r.bfsQueriesPerSecond
+                  << ", \"peak_memory_bytes\": " << r.peakMemory << "}"
+                  << (i + 1 < sizes.size() ? ",\n" : "\n");
+        std::cout.flush();
+    }
+    std::cout << "  ]\n}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "maze.hpp"
+#include <cstdint>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+/* An effectively infinite maze made of square chunks that are generated on demand.
+ *
+ * Every chunk is a regular Maze generated from the world seed hashed with the chunk coordinates, so
+ * any chunk can be built alone and always comes out the same. The outer walls of a chunk are closed
+ * except for one opening per side. The position of the opening only depends on the seed and on the
+ * coordinates of the shared edge, so two neighbors agree on it without generating each other.
+ *
+ * Chunks live in an LRU cache bounded by a memory budget, and isOpen() answers queries in world
+ * coordinates. Since chunks are plain Mazes, print() and the path finders work on each one of them.
+ */
+struct ChunkedMaze
+{
+    uint32_t seed;
+    size_t chunkSize;
+    // cache statistics
+    size_t hits = 0, misses = 0;
+
+    ChunkedMaze(uint32_t seed, size_t chunkSize = 32, size_t memoryBudget = 16 * 1024 * 1024)
+        : seed(seed), chunkSize(chunkSize)
+    {
+        if (chunkSize < 2)
+            throw std::invalid_argument("ChunkedMaze chunks must be at least 2x2");
+        capacity = std::max<size_t>(1, memoryBudget / chunkBytes(chunkSize));
+    }
+
+    // builds the chunk (cx, cy) from scratch, without touching the cache
+    static Maze generateChunk(uint32_t seed, size_t chunkSize, int64_t cx, int64_t cy)
+    {
+        Maze chunk(chunkSize, chunkSize, 0);
+        uint64_t state = hash(seed, cx, cy, 0);
+        chunk.generate([&state]()
+                       {
+                           // splitmix64, enough for picking among at most 4 neighbors
+                           uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                           z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                           z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                           return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+                       });
+
+        const size_t last = chunkSize - 1;
+        chunk.setWall(0, edgeOpening(seed, chunkSize, cx, cy, false), Direction::LEFT, false);
+        chunk.setWall(last, edgeOpening(seed, chunkSize, cx + 1, cy, false), Direction::RIGHT, false);
+        chunk.setWall(edgeOpening(seed, chunkSize, cx, cy, true), 0, Direction::UP, false);
+        chunk.setWall(edgeOpening(seed, chunkSize, cx, cy + 1, true), last, Direction::DOWN, false);
+        return chunk;
+    }
+
+    // the chunk (cx, cy), generated if it is not cached. the reference is valid until the next call
+    const Maze &chunk(int64_t cx, int64_t cy)
+    {
+        const Key key{cx, cy};
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            ++hits;
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->second;
+        }
+
+        ++misses;
+        if (lru.size() >= capacity)
+        {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+        lru.emplace_front(key, generateChunk(seed, chunkSize, cx, cy));
+        index.emplace(key, lru.begin());
+        return lru.front().second;
+    }
+
+    // true if there is no wall between the world cell (x, y) and its neighbor in the given direction
+    bool isOpen(int64_t x, int64_t y, Direction dir)
+    {
+        const int64_t size = static_cast<int64_t>(chunkSize);
+        const int64_t cx = floorDiv(x, size), cy = floorDiv(y, size);
+        // both chunks open the same cell of a shared edge, so asking this side is enough
+        return chunk(cx, cy).isOpen(static_cast<size_t>(x - cx * size), static_cast<size_t>(y - cy * size), dir);
+    }
+
+    size_t cachedChunks() const { return lru.size(); }
+    size_t maxCachedChunks() const { return capacity; }
+
+    // approximate memory used by one cached chunk, walls plus bookkeeping
+    static size_t chunkBytes(size_t chunkSize)
+    {
+        const size_t wallBits = 2 * chunkSize * (chunkSize + 1);
+        return sizeof(Maze) + (wallBits + 7) / 8 + 4 * sizeof(void *) + sizeof(Key);
+    }
+
+private:
+    struct Key
+    {
+        int64_t cx, cy;
+        bool operator==(const Key &other) const { return cx == other.cx && cy == other.cy; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const { return static_cast<size_t>(hash(0, key.cx, key.cy, 0)); }
+    };
+
+    size_t capacity = 1;
+    std::list<std::pair<Key, Maze>> lru;
+    std::unordered_map<Key, std::list<std::pair<Key, Maze>>::iterator, KeyHash> index;
+
+    static int64_t floorDiv(int64_t a, int64_t b)
+    {
+        int64_t q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    static uint64_t hash(uint32_t seed, int64_t cx, int64_t cy, uint64_t salt)
+    {
+        uint64_t h = seed ^ (salt * 0xD6E8FEB86659FD93ull);
+        for (uint64_t v : {static_cast<uint64_t>(cx), static_cast<uint64_t>(cy)})
+        {
+            h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDull;
+            h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53ull;
+            h ^= h >> 33;
+        }
+        return h;
+    }
+
+    // position of the opening on the left edge (vertical) or top edge (horizontal) of chunk (cx, cy)
+    static size_t edgeOpening(uint32_t seed, size_t chunkSize, int64_t cx, int64_t cy, bool horizontal)
+    {
+        return static_cast<size_t>(hash(seed, cx, cy, horizontal ? 2 : 1) % chunkSize);
+    }
+};
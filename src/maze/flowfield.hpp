@@ -0,0 +1,159 @@
+#pragma once
+#include "maze.hpp"
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/* Flow fields for up to 64 goals over a wall layout.
+ *
+ * All the breadth first searches run at the same time: every cell keeps a 64 bit mask where bit i
+ * tells that source i already reached it. One BFS level ORs the frontier masks of the active cells
+ * into their open neighbors, so a single sweep over the maze advances every source together.
+ *
+ * For each source there is a direction plane with 2 bits per cell (32 cells per word) holding the
+ * direction an agent in that cell should walk to get one step closer to the source. On top of that we
+ * keep the distance to the nearest source and which source it is, so agents that only want "any goal"
+ * can follow that one.
+ */
+struct FlowField
+{
+    static constexpr size_t MaxSources = 64;
+    static constexpr uint32_t Unreachable = std::numeric_limits<uint32_t>::max();
+
+    size_t width = 0, height = 0;
+    std::vector<std::pair<size_t, size_t>> sources;
+
+    FlowField() = default;
+
+    template <WallLayout Layout>
+    FlowField(const Layout &maze, const std::vector<std::pair<size_t, size_t>> &sources)
+        : width(maze.width), height(maze.height), sources(sources)
+    {
+        if (sources.size() > MaxSources)
+            throw std::invalid_argument("FlowField supports at most 64 sources");
+
+        const size_t cells = width * height;
+        wordsPerPlane = (cells + 31) / 32;
+        directions.assign(wordsPerPlane * sources.size(), 0);
+        distances.assign(cells, Unreachable);
+        nearestSource.assign(cells, 0);
+
+        // visited: sources that already reached the cell. frontier: sources that reached it in the
+        // current level. pending: sources that will reach it in the next level. exits: open walls.
+        // kept together so touching a neighbor costs a single cache line
+        struct Cell
+        {
+            uint64_t visited = 0, frontier = 0, pending = 0;
+            uint8_t exits = 0;
+        };
+        std::vector<Cell> state(cells);
+        std::vector<size_t> active, next;
+
+        // every cell is expanded once per level a new source reaches it, so read the walls only once
+        for (size_t y = 0; y < height; ++y)
+            for (size_t x = 0; x < width; ++x)
+                for (uint8_t d = 0; d < 4; ++d)
+                    if (Maze::isInside(x, y, static_cast<Direction>(d), width, height) && maze.isOpen(x, y, static_cast<Direction>(d)))
+                        state[y * width + x].exits |= uint8_t(1) << d;
+
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            auto [x, y] = sources[i];
+            if (x >= width || y >= height)
+                throw std::out_of_range("FlowField source outside of the maze");
+            size_t cell = y * width + x;
+            if (state[cell].frontier == 0)
+                active.push_back(cell);
+            state[cell].frontier |= uint64_t(1) << i;
+            state[cell].visited |= uint64_t(1) << i;
+            if (distances[cell] == Unreachable)
+            {
+                distances[cell] = 0;
+                nearestSource[cell] = static_cast<uint8_t>(i);
+            }
+        }
+
+        for (uint32_t level = 1; !active.empty(); ++level)
+        {
+            next.clear();
+            for (size_t cell : active)
+            {
+                size_t x = cell % width, y = cell / width;
+                const uint64_t bits = state[cell].frontier;
+                const uint8_t exits = state[cell].exits;
+                for (uint8_t d = 0; d < 4; ++d)
+                {
+                    if (!(exits & (uint8_t(1) << d)))
+                        continue;
+                    auto dir = static_cast<Direction>(d);
+                    auto [nx, ny] = Maze::step(x, y, dir);
+                    size_t neighbor = ny * width + nx;
+                    Cell &n = state[neighbor];
+                    uint64_t fresh = bits & ~n.visited & ~n.pending;
+                    if (fresh == 0)
+                        continue;
+                    if (n.pending == 0)
+                        next.push_back(neighbor);
+                    n.pending |= fresh;
+                    // walking back the way we came leads to the sources that just arrived
+                    setDirections(neighbor, fresh, opposite(dir));
+                }
+                state[cell].frontier = 0;
+            }
+
+            for (size_t cell : next)
+            {
+                Cell &c = state[cell];
+                uint64_t arrived = c.pending;
+                c.pending = 0;
+                c.frontier = arrived;
+                c.visited |= arrived;
+                if (distances[cell] == Unreachable)
+                {
+                    distances[cell] = level;
+                    nearestSource[cell] = static_cast<uint8_t>(std::countr_zero(arrived));
+                }
+            }
+            std::swap(active, next);
+        }
+    }
+
+    // direction to walk from (x, y) towards the given source. meaningless on the source cell itself
+    // and on cells the source cannot reach, check distance() first
+    Direction direction(size_t source, size_t x, size_t y) const
+    {
+        size_t cell = y * width + x;
+        uint64_t word = directions[source * wordsPerPlane + cell / 32];
+        return static_cast<Direction>((word >> (2 * (cell % 32))) & 3);
+    }
+
+    // number of steps from (x, y) to the nearest source, or Unreachable
+    uint32_t distance(size_t x, size_t y) const { return distances[y * width + x]; }
+
+    // index of the nearest source. ties are broken by the lowest index
+    size_t nearest(size_t x, size_t y) const { return nearestSource[y * width + x]; }
+
+    Direction directionToNearest(size_t x, size_t y) const { return direction(nearest(x, y), x, y); }
+
+private:
+    size_t wordsPerPlane = 0;
+    std::vector<uint64_t> directions;
+    std::vector<uint32_t> distances;
+    std::vector<uint8_t> nearestSource;
+
+    void setDirections(size_t cell, uint64_t bits, Direction dir)
+    {
+        const size_t word = cell / 32;
+        const uint64_t value = uint64_t(static_cast<uint8_t>(dir)) << (2 * (cell % 32));
+        while (bits)
+        {
+            size_t source = std::countr_zero(bits);
+            bits &= bits - 1;
+            // planes start zeroed and every (cell, source) pair is written once, so OR is enough
+            directions[source * wordsPerPlane + word] |= value;
+        }
+    }
+};
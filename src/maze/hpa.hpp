@@ -0,0 +1,418 @@
+#pragma once
+#include "maze.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Hierarchical path finding (HPA*) over a wall layout.
+ *
+ * The maze is split in square clusters. Every cell that has an open wall to a cell of another cluster
+ * is an entrance, and for each cluster we precompute the distances between all pairs of its entrances,
+ * walking only inside the cluster. Crossing between two clusters always costs one step, so those edges
+ * are not stored: they are found from the walls when needed.
+ *
+ * A query connects the start and the goal to the entrances of their clusters, runs A* on that small
+ * abstract graph and then refines every leg with a breadth first search restricted to one cluster.
+ *
+ * The cache does not own the maze, every call that needs the walls receives it. Changing walls only
+ * requires rebuilding the clusters on both sides of the wall, see update().
+ */
+struct HPACache
+{
+    static constexpr uint16_t Unreachable = std::numeric_limits<uint16_t>::max();
+
+    struct Cluster
+    {
+        // global cell indices (y * width + x), sorted
+        std::vector<uint32_t> entrances;
+        // entrances.size() x entrances.size() matrix of intra cluster distances
+        std::vector<uint16_t> distances;
+    };
+
+    size_t width = 0, height = 0, clusterSize = 0;
+    size_t clustersX = 0, clustersY = 0;
+    std::vector<Cluster> clusters;
+
+    HPACache() = default;
+
+    // threads == 0 uses one worker per hardware thread
+    template <WallLayout Layout>
+    HPACache(const Layout &maze, size_t clusterSize = 32, size_t threads = 0)
+        : width(maze.width), height(maze.height), clusterSize(clusterSize)
+    {
+        // distances inside a cluster must fit in 16 bits
+        if (clusterSize == 0 || clusterSize > 255)
+            throw std::invalid_argument("HPACache cluster size must be between 1 and 255");
+        if (width * height >= std::numeric_limits<uint32_t>::max())
+            throw std::invalid_argument("HPACache supports at most 2^32 - 1 cells");
+
+        clustersX = (width + clusterSize - 1) / clusterSize;
+        clustersY = (height + clusterSize - 1) / clusterSize;
+        clusters.resize(clustersX * clustersY);
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, clusters.size());
+
+        // clusters are independent, so workers just grab the next batch until none is left
+        std::atomic<size_t> nextCluster{0};
+        auto worker = [&]()
+        {
+            LocalSearch search;
+            constexpr size_t batch = 16;
+            for (size_t first = nextCluster.fetch_add(batch); first < clusters.size(); first = nextCluster.fetch_add(batch))
+                for (size_t c = first; c < std::min(first + batch, clusters.size()); ++c)
+                    buildCluster(maze, c, search);
+        };
+        if (threads <= 1)
+        {
+            worker();
+            return;
+        }
+        std::vector<std::jthread> pool;
+        for (size_t i = 0; i < threads; ++i)
+            pool.emplace_back(worker);
+    }
+
+    // rebuilds the clusters on both sides of the wall between (x, y) and its neighbor in dir. call it
+    // after changing that wall in the maze
+    template <WallLayout Layout>
+    void update(const Layout &maze, size_t x, size_t y, Direction dir)
+    {
+        LocalSearch search;
+        size_t a = clusterOf(x, y);
+        buildCluster(maze, a, search);
+        if (!Maze::isInside(x, y, dir, width, height))
+            return;
+        auto [nx, ny] = Maze::step(x, y, dir);
+        size_t b = clusterOf(nx, ny);
+        if (b != a)
+            buildCluster(maze, b, search);
+    }
+
+    // shortest path from start to goal, both included. empty if the goal cannot be reached
+    template <WallLayout Layout>
+    std::vector<std::pair<size_t, size_t>> findPath(const Layout &maze, std::pair<size_t, size_t> start, std::pair<size_t, size_t> goal) const
+    {
+        if (maze.width != width || maze.height != height)
+            throw std::invalid_argument("HPACache was built for a maze of different dimensions");
+        if (start.first >= width || start.second >= height || goal.first >= width || goal.second >= height)
+            throw std::invalid_argument("HPACache path start and goal must be cells of the maze");
+        const uint32_t startCell = static_cast<uint32_t>(start.second * width + start.first);
+        const uint32_t goalCell = static_cast<uint32_t>(goal.second * width + goal.first);
+        if (startCell == goalCell)
+            return {start};
+
+        constexpr uint32_t StartNode = std::numeric_limits<uint32_t>::max() - 1;
+        constexpr uint32_t GoalNode = std::numeric_limits<uint32_t>::max();
+
+        LocalSearch fromStart, fromGoal;
+        const size_t startCluster = clusterOf(start.first, start.second);
+        const size_t goalCluster = clusterOf(goal.first, goal.second);
+        localSearch(maze, startCluster, startCell, fromStart);
+        localSearch(maze, goalCluster, goalCell, fromGoal);
+
+        // A* over the entrances. the manhattan distance never overestimates on a grid
+        auto heuristic = [&](uint32_t cell) -> uint32_t
+        {
+            size_t x = cell % width, y = cell / width;
+            return static_cast<uint32_t>((x > goal.first ? x - goal.first : goal.first - x) + (y > goal.second ? y - goal.second : goal.second - y));
+        };
+        using Entry = std::tuple<uint32_t, uint32_t, uint32_t>; // f, g, node
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> open;
+        // best known cost and parent of every node touched by the search
+        std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> visited;
+        auto relax = [&](uint32_t node, uint32_t g, uint32_t from)
+        {
+            auto [it, inserted] = visited.try_emplace(node, g, from);
+            if (!inserted)
+            {
+                if (it->second.first <= g)
+                    return;
+                it->second = {g, from};
+            }
+            open.emplace(g + (node == GoalNode ? 0 : heuristic(node)), g, node);
+        };
+
+        const Cluster &first = clusters[startCluster];
+        for (uint32_t entrance : first.entrances)
+        {
+            uint16_t d = fromStart.distanceTo(*this, entrance);
+            if (d != Unreachable)
+                relax(entrance, d, StartNode);
+        }
+        if (startCluster == goalCluster)
+        {
+            uint16_t d = fromStart.distanceTo(*this, goalCell);
+            if (d != Unreachable)
+                relax(GoalNode, d, StartNode);
+        }
+
+        bool found = false;
+        while (!open.empty())
+        {
+            auto [f, g, node] = open.top();
+            open.pop();
+            if (visited[node].first != g)
+                continue;
+            if (node == GoalNode)
+            {
+                found = true;
+                break;
+            }
+
+            size_t x = node % width, y = node / width;
+            size_t c = clusterOf(x, y);
+            const Cluster &cluster = clusters[c];
+            size_t i = entranceIndex(cluster, node);
+            const size_t n = cluster.entrances.size();
+            for (size_t j = 0; j < n; ++j)
+            {
+                uint16_t d = cluster.distances[i * n + j];
+                if (j != i && d != Unreachable)
+                    relax(cluster.entrances[j], g + d, node);
+            }
+            for (uint8_t d = 0; d < 4; ++d)
+            {
+                auto dir = static_cast<Direction>(d);
+                if (!Maze::isInside(x, y, dir, width, height) || !maze.isOpen(x, y, dir))
+                    continue;
+                auto [nx, ny] = Maze::step(x, y, dir);
+                if (clusterOf(nx, ny) != c)
+                    relax(static_cast<uint32_t>(ny * width + nx), g + 1, node);
+            }
+            if (c == goalCluster)
+            {
+                uint16_t d = fromGoal.distanceTo(*this, node);
+                if (d != Unreachable)
+                    relax(GoalNode, g + d, node);
+            }
+        }
+        if (!found)
+            return {};
+
+        // abstract path, from the goal back to the start
+        std::vector<uint32_t> waypoints{goalCell};
+        for (uint32_t node = visited[GoalNode].second; node != StartNode; node = visited[node].second)
+            waypoints.push_back(node);
+        waypoints.push_back(startCell);
+        std::reverse(waypoints.begin(), waypoints.end());
+
+        // refine every leg. legs inside a cluster are walked with a local search, legs between
+        // clusters are a single step
+        std::vector<std::pair<size_t, size_t>> path{start};
+        LocalSearch leg;
+        for (size_t k = 1; k < waypoints.size(); ++k)
+        {
+            uint32_t from = waypoints[k - 1], to = waypoints[k];
+            size_t fromCluster = clusterOf(from % width, from / width);
+            if (fromCluster != clusterOf(to % width, to / width))
+            {
+                path.emplace_back(to % width, to / width);
+                continue;
+            }
+            // search from the destination so parents point forward along the path
+            localSearch(maze, fromCluster, to, leg, from);
+            for (uint32_t cell = from; cell != to;)
+            {
+                auto [nx, ny] = Maze::step(cell % width, cell / width, leg.parentDirection(*this, cell));
+                cell = static_cast<uint32_t>(ny * width + nx);
+                path.emplace_back(nx, ny);
+            }
+        }
+        return path;
+    }
+
+    // binary snapshot of the abstract graph so it can be loaded instead of rebuilt. it uses the native
+    // byte order and does not store the walls, load it only next to the maze it was built from
+    void save(std::ostream &out) const
+    {
+        out.write(Magic, sizeof(Magic));
+        writeValue<uint64_t>(out, width);
+        writeValue<uint64_t>(out, height);
+        writeValue<uint64_t>(out, clusterSize);
+        for (const Cluster &cluster : clusters)
+        {
+            writeValue<uint32_t>(out, static_cast<uint32_t>(cluster.entrances.size()));
+            out.write(reinterpret_cast<const char *>(cluster.entrances.data()), cluster.entrances.size() * sizeof(uint32_t));
+            out.write(reinterpret_cast<const char *>(cluster.distances.data()), cluster.distances.size() * sizeof(uint16_t));
+        }
+    }
+
+    static HPACache load(std::istream &in)
+    {
+        char magic[sizeof(Magic)];
+        in.read(magic, sizeof(magic));
+        if (!in || !std::equal(magic, magic + sizeof(magic), Magic))
+            throw std::runtime_error("not an HPA cache file");
+
+        HPACache cache;
+        cache.width = readValue<uint64_t>(in);
+        cache.height = readValue<uint64_t>(in);
+        cache.clusterSize = readValue<uint64_t>(in);
+        if (!in || cache.clusterSize == 0 || cache.clusterSize > 255 ||
+            (cache.width > 0 && cache.height >= std::numeric_limits<uint32_t>::max() / cache.width))
+            throw std::runtime_error("corrupted HPA cache header");
+        cache.clustersX = (cache.width + cache.clusterSize - 1) / cache.clusterSize;
+        cache.clustersY = (cache.height + cache.clusterSize - 1) / cache.clusterSize;
+        // clusters are added as they are read, so a corrupt header runs out of data before it runs out of memory
+        const size_t clusterCount = cache.clustersX * cache.clustersY;
+        for (size_t c = 0; c < clusterCount; ++c)
+        {
+            uint32_t n = readValue<uint32_t>(in);
+            if (!in)
+                break;
+            // entrances are cells on the border of the cluster
+            if (n > 4 * cache.clusterSize)
+                throw std::runtime_error("corrupted HPA cache cluster");
+            Cluster &cluster = cache.clusters.emplace_back();
+            cluster.entrances.resize(n);
+            cluster.distances.resize(size_t(n) * n);
+            in.read(reinterpret_cast<char *>(cluster.entrances.data()), n * sizeof(uint32_t));
+            in.read(reinterpret_cast<char *>(cluster.distances.data()), cluster.distances.size() * sizeof(uint16_t));
+            if (!in)
+                break;
+            // queries index the maze and the cluster searches with these, and look them up by binary search
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint32_t cell = cluster.entrances[i];
+                if (cell >= cache.width * cache.height || cache.clusterOf(cell % cache.width, cell / cache.width) != c ||
+                    (i > 0 && cluster.entrances[i - 1] >= cell))
+                    throw std::runtime_error("corrupted HPA cache entrance");
+            }
+        }
+        if (!in)
+            throw std::runtime_error("truncated HPA cache file");
+        return cache;
+    }
+
+    // total number of entrances, the size of the abstract graph
+    size_t entranceCount() const
+    {
+        size_t total = 0;
+        for (const Cluster &cluster : clusters)
+            total += cluster.entrances.size();
+        return total;
+    }
+
+private:
+    static constexpr char Magic[4] = {'H', 'P', 'A', '1'};
+
+    // breadth first search restricted to one cluster. reused between calls to avoid allocations
+    struct LocalSearch
+    {
+        size_t x0 = 0, y0 = 0, w = 0, h = 0;
+        std::vector<uint16_t> distance;
+        // direction from each cell to its parent, towards the origin of the search
+        std::vector<Direction> parent;
+        std::vector<uint32_t> queue;
+
+        size_t local(const HPACache &cache, uint32_t cell) const { return (cell / cache.width - y0) * w + (cell % cache.width - x0); }
+        uint16_t distanceTo(const HPACache &cache, uint32_t cell) const { return distance[local(cache, cell)]; }
+        Direction parentDirection(const HPACache &cache, uint32_t cell) const { return parent[local(cache, cell)]; }
+    };
+
+    size_t clusterOf(size_t x, size_t y) const { return (y / clusterSize) * clustersX + x / clusterSize; }
+
+    static size_t entranceIndex(const Cluster &cluster, uint32_t cell)
+    {
+        return std::lower_bound(cluster.entrances.begin(), cluster.entrances.end(), cell) - cluster.entrances.begin();
+    }
+
+    // stops as soon as stopAt is reached, when given
+    template <WallLayout Layout>
+    void localSearch(const Layout &maze, size_t c, uint32_t origin, LocalSearch &search, uint32_t stopAt = std::numeric_limits<uint32_t>::max()) const
+    {
+        search.x0 = (c % clustersX) * clusterSize;
+        search.y0 = (c / clustersX) * clusterSize;
+        search.w = std::min(clusterSize, width - search.x0);
+        search.h = std::min(clusterSize, height - search.y0);
+        search.distance.assign(search.w * search.h, Unreachable);
+        search.parent.resize(search.w * search.h);
+        search.queue.clear();
+
+        search.distance[search.local(*this, origin)] = 0;
+        search.queue.push_back(origin);
+        for (size_t head = 0; head < search.queue.size(); ++head)
+        {
+            uint32_t cell = search.queue[head];
+            if (cell == stopAt)
+                return;
+            size_t x = cell % width, y = cell / width;
+            uint16_t next = search.distance[search.local(*this, cell)] + 1;
+            for (uint8_t d = 0; d < 4; ++d)
+            {
+                auto dir = static_cast<Direction>(d);
+                if (!Maze::isInside(x, y, dir, width, height) || !maze.isOpen(x, y, dir))
+                    continue;
+                auto [nx, ny] = Maze::step(x, y, dir);
+                if (nx < search.x0 || ny < search.y0 || nx >= search.x0 + search.w || ny >= search.y0 + search.h)
+                    continue;
+                size_t local = (ny - search.y0) * search.w + (nx - search.x0);
+                if (search.distance[local] != Unreachable)
+                    continue;
+                search.distance[local] = next;
+                search.parent[local] = opposite(dir);
+                search.queue.push_back(static_cast<uint32_t>(ny * width + nx));
+            }
+        }
+    }
+
+    template <WallLayout Layout>
+    void buildCluster(const Layout &maze, size_t c, LocalSearch &search)
+    {
+        Cluster &cluster = clusters[c];
+        cluster.entrances.clear();
+
+        const size_t x0 = (c % clustersX) * clusterSize, y0 = (c / clustersX) * clusterSize;
+        const size_t x1 = std::min(x0 + clusterSize, width), y1 = std::min(y0 + clusterSize, height);
+        for (size_t y = y0; y < y1; ++y)
+        {
+            for (size_t x = x0; x < x1; ++x)
+            {
+                // only border cells can be entrances
+                if (x != x0 && y != y0 && x + 1 != x1 && y + 1 != y1)
+                    continue;
+                bool entrance = (y == y0 && y > 0 && maze.isOpen(x, y, Direction::UP)) ||
+                                (x + 1 == x1 && x1 < width && maze.isOpen(x, y, Direction::RIGHT)) ||
+                                (y + 1 == y1 && y1 < height && maze.isOpen(x, y, Direction::DOWN)) ||
+                                (x == x0 && x > 0 && maze.isOpen(x, y, Direction::LEFT));
+                if (entrance)
+                    cluster.entrances.push_back(static_cast<uint32_t>(y * width + x));
+            }
+        }
+
+        const size_t n = cluster.entrances.size();
+        cluster.distances.assign(n * n, Unreachable);
+        for (size_t i = 0; i < n; ++i)
+        {
+            localSearch(maze, c, cluster.entrances[i], search);
+            for (size_t j = 0; j < n; ++j)
+                cluster.distances[i * n + j] = search.distanceTo(*this, cluster.entrances[j]);
+        }
+    }
+
+    template <typename T>
+    static void writeValue(std::ostream &out, T value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static T readValue(std::istream &in)
+    {
+        T value{};
+        in.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return value;
+    }
+};
@@ -1,5 +1,11 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
 #include <cstdint>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 struct Random
 {
@@ -10,24 +16,112 @@ private:
 public:
     static uint8_t next()
     {
-        // todo: return the next random number from the array
-        return 0;
+        uint8_t value = randomNumbers[index];
+        index = (index + 1) % 100;
+        return value;
     }
 
     static void setIndex(uint8_t i)
     {
-        index = i;
+        index = i % 100;
     }
 };
 
+// clockwise order, starting from the top neighbor. the generator relies on this order
+enum class Direction : uint8_t
+{
+    UP,
+    RIGHT,
+    DOWN,
+    LEFT
+};
+
+inline Direction opposite(Direction dir)
+{
+    return static_cast<Direction>((static_cast<uint8_t>(dir) + 2) & 3);
+}
+
+// anything that exposes a width, a height and the walls between cells. the flow fields and the
+// path finders only depend on this, so they can run on a Maze or on any other wall storage
+template <typename T>
+concept WallLayout = requires(const T &layout, size_t x, size_t y, Direction dir) {
+    { layout.width } -> std::convertible_to<size_t>;
+    { layout.height } -> std::convertible_to<size_t>;
+    { layout.isOpen(x, y, dir) } -> std::convertible_to<bool>;
+};
+
+// ascii drawing of any wall layout, one line for the top walls and one line per row of cells
+template <WallLayout Layout>
+std::string printWalls(const Layout &maze)
+{
+    const size_t width = maze.width, height = maze.height;
+    std::string out;
+    out.reserve((height + 1) * (2 * width + 3));
+    for (size_t x = 0; x < width; ++x)
+        out += maze.isOpen(x, 0, Direction::UP) ? "  " : " _";
+    out += "  \n";
+    for (size_t y = 0; y < height; ++y)
+    {
+        out += maze.isOpen(0, y, Direction::LEFT) ? ' ' : '|';
+        for (size_t x = 0; x < width; ++x)
+        {
+            out += maze.isOpen(x, y, Direction::DOWN) ? ' ' : '_';
+            out += maze.isOpen(x, y, Direction::RIGHT) ? ' ' : '|';
+        }
+        out += " \n";
+    }
+    return out;
+}
+
 struct Maze
 {
     size_t width, height, randomIndex;
 
-    // todo: store the data in a meaningful way for you. I recommend a vector of bools and use matrix linearization technique
-    // tip: I recommend to store the walls(not the cells) as horizontals and verticals in separate vectors to make your life easier
+    // walls are stored, not cells. linearized matrices:
+    // horizontals: (height + 1) rows of width walls. row y is the wall above the cells of line y
+    // verticals: height rows of (width + 1) walls. column x is the wall to the left of the cells of column x
+    std::vector<bool> horizontals;
+    std::vector<bool> verticals;
+
+    Maze(size_t width, size_t height, uint8_t index)
+        : width(width), height(height), randomIndex(index),
+          horizontals((height + 1) * width, true), verticals(height * (width + 1), true) {}
 
-    Maze(size_t width, size_t height, uint8_t index) : width(width), height(height), randomIndex(index) {}
+    // true if there is no wall between the cell (x, y) and its neighbor in the given direction
+    bool isOpen(size_t x, size_t y, Direction dir) const
+    {
+        switch (dir)
+        {
+        case Direction::UP:
+            return !horizontals[y * width + x];
+        case Direction::RIGHT:
+            return !verticals[y * (width + 1) + x + 1];
+        case Direction::DOWN:
+            return !horizontals[(y + 1) * width + x];
+        case Direction::LEFT:
+            return !verticals[y * (width + 1) + x];
+        }
+        return false;
+    }
+
+    void setWall(size_t x, size_t y, Direction dir, bool wall)
+    {
+        switch (dir)
+        {
+        case Direction::UP:
+            horizontals[y * width + x] = wall;
+            break;
+        case Direction::RIGHT:
+            verticals[y * (width + 1) + x + 1] = wall;
+            break;
+        case Direction::DOWN:
+            horizontals[(y + 1) * width + x] = wall;
+            break;
+        case Direction::LEFT:
+            verticals[y * (width + 1) + x] = wall;
+            break;
+        }
+    }
 
     /* In order to give consistency on how to decide the direction of the next cell, the following procedure should be followed:
      * List all visitable neighbors of the current cell;
@@ -38,14 +132,96 @@ struct Maze
      */
     void generate()
     {
-        // besides the walls, we need to store a way to check if the cell is visited or not. you may want to use a linearized matrix as vector of bools
-        // you should keep a stack of your current path so far, so you can backtrack when you encounter a dead end
-        // remember to (re)set the index at the begining of the maze generation
+        Random::setIndex(static_cast<uint8_t>(randomIndex));
+        generate(Random::next);
+    }
+
+    // same procedure as above, but drawing the random numbers from any callable instead of the table
+    template <typename NextRandom>
+    void generate(NextRandom &&next)
+    {
+        std::fill(horizontals.begin(), horizontals.end(), true);
+        std::fill(verticals.begin(), verticals.end(), true);
+        if (width == 0 || height == 0)
+            return;
+
+        std::vector<bool> visited(width * height, false);
+        // the current path is stored as the direction of every step taken, so backtracking only needs
+        // to walk the last step in reverse. one byte per step instead of two coordinates
+        std::vector<Direction> path;
+        size_t x = 0, y = 0;
+        visited[0] = true;
+
+        while (true)
+        {
+            Direction visitable[4];
+            size_t visitableCount = 0;
+            if (y > 0 && !visited[(y - 1) * width + x])
+                visitable[visitableCount++] = Direction::UP;
+            if (x + 1 < width && !visited[y * width + x + 1])
+                visitable[visitableCount++] = Direction::RIGHT;
+            if (y + 1 < height && !visited[(y + 1) * width + x])
+                visitable[visitableCount++] = Direction::DOWN;
+            if (x > 0 && !visited[y * width + x - 1])
+                visitable[visitableCount++] = Direction::LEFT;
+
+            if (visitableCount == 0)
+            {
+                if (path.empty())
+                    break;
+                std::tie(x, y) = step(x, y, opposite(path.back()));
+                path.pop_back();
+                continue;
+            }
+
+            Direction dir = visitable[0];
+            if (visitableCount > 1)
+                dir = visitable[next() % visitableCount];
+
+            setWall(x, y, dir, false);
+            std::tie(x, y) = step(x, y, dir);
+            visited[y * width + x] = true;
+            path.push_back(dir);
+        }
+    }
+
+    // true if (x, y) has a neighbor in the given direction inside a width x height grid
+    static bool isInside(size_t x, size_t y, Direction dir, size_t width, size_t height)
+    {
+        switch (dir)
+        {
+        case Direction::UP:
+            return y > 0;
+        case Direction::RIGHT:
+            return x + 1 < width;
+        case Direction::DOWN:
+            return y + 1 < height;
+        case Direction::LEFT:
+            return x > 0;
+        }
+        return false;
+    }
+
+    // coordinates of the neighbor of (x, y) in the given direction. no bounds checking
+    static std::pair<size_t, size_t> step(size_t x, size_t y, Direction dir)
+    {
+        switch (dir)
+        {
+        case Direction::UP:
+            return {x, y - 1};
+        case Direction::RIGHT:
+            return {x + 1, y};
+        case Direction::DOWN:
+            return {x, y + 1};
+        case Direction::LEFT:
+            return {x - 1, y};
+        }
+        return {x, y};
     }
 
     // print to the specific output stream
     std::string print() const
     {
-        return "";
+        return printWalls(*this);
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,320 @@
+#pragma once
+#include "maze.hpp"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Binary maze files.
+ *
+ * Layout, all integers little endian:
+ *   0  char[4]  magic "MAZE"
+ *   4  uint32   version (1)
+ *   8  uint64   width
+ *  16  uint64   height
+ *  24  uint64   random index used to generate it
+ *  32  horizontal walls, (height + 1) * width bits
+ *      vertical walls, height * (width + 1) bits, starting at the next byte
+ *
+ * Bits use the same linearization as Maze::horizontals and Maze::verticals and are packed least
+ * significant bit first inside each byte, so the file reads the same on any host.
+ */
+struct MazeFile
+{
+    static constexpr char Magic[4] = {'M', 'A', 'Z', 'E'};
+    static constexpr uint32_t Version = 1;
+    static constexpr size_t HeaderSize = 32;
+
+    static size_t horizontalBytes(size_t width, size_t height) { return ((height + 1) * width + 7) / 8; }
+    static size_t verticalBytes(size_t width, size_t height) { return (height * (width + 1) + 7) / 8; }
+    static size_t fileSize(size_t width, size_t height) { return HeaderSize + horizontalBytes(width, height) + verticalBytes(width, height); }
+
+    static void write(const Maze &maze, std::ostream &out)
+    {
+        unsigned char header[HeaderSize] = {};
+        std::memcpy(header, Magic, sizeof(Magic));
+        storeLittleEndian(header + 4, Version, 4);
+        storeLittleEndian(header + 8, maze.width, 8);
+        storeLittleEndian(header + 16, maze.height, 8);
+        storeLittleEndian(header + 24, maze.randomIndex, 8);
+        out.write(reinterpret_cast<const char *>(header), HeaderSize);
+
+        std::vector<char> bytes = pack(maze.horizontals);
+        out.write(bytes.data(), bytes.size());
+        bytes = pack(maze.verticals);
+        out.write(bytes.data(), bytes.size());
+    }
+
+    static void save(const Maze &maze, const std::string &path)
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            throw std::runtime_error("cannot create maze file " + path);
+        write(maze, out);
+        if (!out)
+            throw std::runtime_error("failed writing maze file " + path);
+    }
+
+    // reads the whole file back into a Maze. use MappedMaze to avoid copying the walls
+    static Maze read(std::istream &in)
+    {
+        unsigned char header[HeaderSize];
+        in.read(reinterpret_cast<char *>(header), HeaderSize);
+        if (!in)
+            throw std::runtime_error("truncated maze file");
+        auto [width, height, randomIndex] = parseHeader(header);
+
+        // a seekable stream must hold the walls before they are allocated
+        const std::streampos walls = in.tellg();
+        if (walls != std::streampos(-1))
+        {
+            in.seekg(0, std::ios::end);
+            const std::streampos end = in.tellg();
+            in.seekg(walls);
+            if (!in || end - walls < static_cast<std::streamoff>(fileSize(width, height) - HeaderSize))
+                throw std::runtime_error("truncated maze file");
+        }
+
+        Maze maze(width, height, static_cast<uint8_t>(randomIndex));
+        std::vector<char> bytes(horizontalBytes(width, height));
+        in.read(bytes.data(), bytes.size());
+        unpack(reinterpret_cast<const unsigned char *>(bytes.data()), maze.horizontals);
+        bytes.resize(verticalBytes(width, height));
+        in.read(bytes.data(), bytes.size());
+        unpack(reinterpret_cast<const unsigned char *>(bytes.data()), maze.verticals);
+        if (!in)
+            throw std::runtime_error("truncated maze file");
+        return maze;
+    }
+
+    static Maze load(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("cannot open maze file " + path);
+        return read(in);
+    }
+
+    /* Validates the header and returns width, height and random index. Dimensions whose wall bit counts do
+     * not fit in a size_t are rejected, so fileSize cannot wrap, and so is a random index the Maze
+     * constructor cannot hold.
+     */
+    static std::tuple<size_t, size_t, size_t> parseHeader(const unsigned char *header)
+    {
+        if (std::memcmp(header, Magic, sizeof(Magic)) != 0)
+            throw std::runtime_error("not a maze file");
+        if (loadLittleEndian(header + 4, 4) != Version)
+            throw std::runtime_error("unsupported maze file version");
+        const uint64_t width = loadLittleEndian(header + 8, 8), height = loadLittleEndian(header + 16, 8);
+        const uint64_t randomIndex = loadLittleEndian(header + 24, 8);
+        // each bit count plus the byte rounding stays below SIZE_MAX, so the two byte counts add up safely
+        constexpr uint64_t MaxBits = std::numeric_limits<size_t>::max() - 7;
+        if (width >= MaxBits || height >= MaxBits || (width > 0 && height + 1 > MaxBits / width) ||
+            (height > 0 && width + 1 > MaxBits / height))
+            throw std::runtime_error("maze file dimensions too large");
+        if (randomIndex > std::numeric_limits<uint8_t>::max())
+            throw std::runtime_error("invalid maze file random index");
+        return {static_cast<size_t>(width), static_cast<size_t>(height), static_cast<size_t>(randomIndex)};
+    }
+
+    static bool bit(const unsigned char *bytes, size_t i) { return (bytes[i / 8] >> (i % 8)) & 1; }
+
+private:
+    static void storeLittleEndian(unsigned char *out, uint64_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; ++i)
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+
+    static uint64_t loadLittleEndian(const unsigned char *in, size_t bytes)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            value |= uint64_t(in[i]) << (8 * i);
+        return value;
+    }
+
+    static std::vector<char> pack(const std::vector<bool> &bits)
+    {
+        std::vector<char> bytes((bits.size() + 7) / 8, 0);
+        for (size_t i = 0; i < bits.size(); ++i)
+            if (bits[i])
+                bytes[i / 8] |= static_cast<char>(1 << (i % 8));
+        return bytes;
+    }
+
+    static void unpack(const unsigned char *bytes, std::vector<bool> &bits)
+    {
+        for (size_t i = 0; i < bits.size(); ++i)
+            bits[i] = bit(bytes, i);
+    }
+};
+
+/* Read only view of a maze file mapped in memory.
+ *
+ * Opening it costs a header check: walls are read straight from the mapped pages, which the OS shares
+ * between every process mapping the same file. It satisfies WallLayout, so printWalls, the flow fields
+ * and the path finders run on it directly.
+ */
+struct MappedMaze
+{
+    size_t width = 0, height = 0, randomIndex = 0;
+
+    explicit MappedMaze(const std::string &path)
+    {
+        map(path);
+        try
+        {
+            if (size < MazeFile::HeaderSize)
+                throw std::runtime_error("truncated maze file");
+            std::tie(width, height, randomIndex) = MazeFile::parseHeader(data);
+            if (size != MazeFile::fileSize(width, height))
+                throw std::runtime_error(size < MazeFile::fileSize(width, height) ? "truncated maze file" : "trailing bytes after maze file");
+        }
+        catch (...)
+        {
+            unmap();
+            throw;
+        }
+        horizontals = data + MazeFile::HeaderSize;
+        verticals = horizontals + MazeFile::horizontalBytes(width, height);
+    }
+
+    MappedMaze(const MappedMaze &) = delete;
+    MappedMaze &operator=(const MappedMaze &) = delete;
+    MappedMaze(MappedMaze &&other) noexcept { *this = std::move(other); }
+    MappedMaze &operator=(MappedMaze &&other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            width = other.width;
+            height = other.height;
+            randomIndex = other.randomIndex;
+            data = std::exchange(other.data, nullptr);
+            size = std::exchange(other.size, 0);
+            horizontals = std::exchange(other.horizontals, nullptr);
+            verticals = std::exchange(other.verticals, nullptr);
+#if defined(_WIN32)
+            mapping = std::exchange(other.mapping, nullptr);
+#endif
+        }
+        return *this;
+    }
+    ~MappedMaze() { unmap(); }
+
+    bool isOpen(size_t x, size_t y, Direction dir) const
+    {
+        switch (dir)
+        {
+        case Direction::UP:
+            return !MazeFile::bit(horizontals, y * width + x);
+        case Direction::RIGHT:
+            return !MazeFile::bit(verticals, y * (width + 1) + x + 1);
+        case Direction::DOWN:
+            return !MazeFile::bit(horizontals, (y + 1) * width + x);
+        case Direction::LEFT:
+            return !MazeFile::bit(verticals, y * (width + 1) + x);
+        }
+        return false;
+    }
+
+    std::string print() const { return printWalls(*this); }
+
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    const unsigned char *horizontals = nullptr;
+    const unsigned char *verticals = nullptr;
+#if defined(_WIN32)
+    HANDLE mapping = nullptr;
+#endif
+
+#if defined(_WIN32)
+    void map(const std::string &path)
+    {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("cannot open maze file " + path);
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            throw std::runtime_error("cannot map maze file " + path);
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping)
+            throw std::runtime_error("cannot map maze file " + path);
+        data = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!data)
+        {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            throw std::runtime_error("cannot map maze file " + path);
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+    }
+
+    void unmap()
+    {
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        data = nullptr;
+        mapping = nullptr;
+        size = 0;
+    }
+#else
+    void map(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open maze file " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("cannot map maze file " + path);
+        }
+        size = static_cast<size_t>(info.st_size);
+        void *address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (address == MAP_FAILED)
+        {
+            size = 0;
+            throw std::runtime_error("cannot map maze file " + path);
+        }
+        data = static_cast<const unsigned char *>(address);
+    }
+
+    void unmap()
+    {
+        if (data)
+            ::munmap(const_cast<unsigned char *>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+#endif
+};
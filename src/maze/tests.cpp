@@ -1,6 +1,10 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "MemoryLeakDetector.h"
 #include "maze.hpp"
+#include "flowfield.hpp"
+#include "hpa.hpp"
+#include "chunked.hpp"
+#include "mazefile.hpp"
 #include <doctest/doctest.h>
 #include <algorithm>
 #include <filesystem>
@@ -13,6 +17,7 @@
 #include <chrono>
 #include <future>
 #include <stdexcept>
+#include <queue>
 
 namespace fs = std::filesystem;
 
@@ -455,4 +460,323 @@ TEST_CASE("File-based maze generation tests") {
             runTestCase(testName, inputFile, outputFile);
         }
     }
-}
\ No newline at end of file
+}
+
+// Plain single source BFS used as reference for the flow fields
+std::vector<uint32_t> referenceDistances(const Maze &maze, size_t sx, size_t sy)
+{
+    std::vector<uint32_t> dist(maze.width * maze.height, FlowField::Unreachable);
+    std::queue<std::pair<size_t, size_t>> queue;
+    dist[sy * maze.width + sx] = 0;
+    queue.emplace(sx, sy);
+    while (!queue.empty())
+    {
+        auto [x, y] = queue.front();
+        queue.pop();
+        for (uint8_t d = 0; d < 4; ++d)
+        {
+            auto dir = static_cast<Direction>(d);
+            if (!maze.isOpen(x, y, dir))
+                continue;
+            auto [nx, ny] = Maze::step(x, y, dir);
+            if (dist[ny * maze.width + nx] != FlowField::Unreachable)
+                continue;
+            dist[ny * maze.width + nx] = dist[y * maze.width + x] + 1;
+            queue.emplace(nx, ny);
+        }
+    }
+    return dist;
+}
+
+TEST_CASE("Flow fields") {
+    Maze maze(40, 25, 3);
+    maze.generate();
+
+    std::vector<std::pair<size_t, size_t>> sources;
+    for (size_t i = 0; i < 64; ++i)
+        sources.emplace_back((i * 7) % maze.width, (i * 11) % maze.height);
+    FlowField field(maze, sources);
+
+    SUBCASE("Following a direction field reaches its source in the shortest path") {
+        for (size_t s = 0; s < sources.size(); s += 9) {
+            auto reference = referenceDistances(maze, sources[s].first, sources[s].second);
+            for (size_t y = 0; y < maze.height; ++y) {
+                for (size_t x = 0; x < maze.width; ++x) {
+                    size_t cx = x, cy = y;
+                    uint32_t steps = 0;
+                    while (cx != sources[s].first || cy != sources[s].second) {
+                        Direction dir = field.direction(s, cx, cy);
+                        REQUIRE(maze.isOpen(cx, cy, dir));
+                        std::tie(cx, cy) = Maze::step(cx, cy, dir);
+                        REQUIRE(++steps <= reference[y * maze.width + x]);
+                    }
+                    CHECK(steps == reference[y * maze.width + x]);
+                }
+            }
+        }
+    }
+
+    SUBCASE("Distance field is the distance to the nearest source") {
+        std::vector<uint32_t> nearest(maze.width * maze.height, FlowField::Unreachable);
+        for (auto [sx, sy] : sources) {
+            auto reference = referenceDistances(maze, sx, sy);
+            for (size_t i = 0; i < nearest.size(); ++i)
+                nearest[i] = std::min(nearest[i], reference[i]);
+        }
+        bool matches = true;
+        for (size_t y = 0; y < maze.height; ++y)
+            for (size_t x = 0; x < maze.width; ++x)
+                matches = matches && field.distance(x, y) == nearest[y * maze.width + x];
+        CHECK(matches);
+
+        size_t s = field.nearest(5, 5);
+        CHECK(referenceDistances(maze, sources[s].first, sources[s].second)[5 * maze.width + 5] == field.distance(5, 5));
+    }
+
+    SUBCASE("More than 64 sources is rejected") {
+        std::vector<std::pair<size_t, size_t>> tooMany(65, {0, 0});
+        CHECK_THROWS_AS(FlowField(maze, tooMany), std::invalid_argument);
+    }
+}
+
+// Checks that a path only walks through open walls, one cell at a time
+bool isValidPath(const Maze &maze, const std::vector<std::pair<size_t, size_t>> &path)
+{
+    for (size_t i = 1; i < path.size(); ++i) {
+        bool connected = false;
+        for (uint8_t d = 0; d < 4; ++d) {
+            auto dir = static_cast<Direction>(d);
+            if (maze.isOpen(path[i - 1].first, path[i - 1].second, dir) && Maze::step(path[i - 1].first, path[i - 1].second, dir) == path[i])
+                connected = true;
+        }
+        if (!connected)
+            return false;
+    }
+    return true;
+}
+
+TEST_CASE("Hierarchical path finding") {
+    Maze maze(60, 45, 7);
+    maze.generate();
+    HPACache cache(maze, 8, 4);
+
+    std::vector<std::pair<std::pair<size_t, size_t>, std::pair<size_t, size_t>>> queries = {
+        {{0, 0}, {59, 44}}, {{59, 0}, {0, 44}}, {{3, 3}, {5, 6}}, {{30, 20}, {31, 20}}, {{12, 40}, {12, 40}}, {{8, 8}, {15, 15}}};
+    for (size_t i = 0; i < 40; ++i)
+        queries.push_back({{(i * 13) % 60, (i * 7) % 45}, {(i * 29 + 5) % 60, (i * 17 + 3) % 45}});
+
+    auto checkQueries = [&](const HPACache &hpa) {
+        for (auto [start, goal] : queries) {
+            auto path = hpa.findPath(maze, start, goal);
+            auto reference = referenceDistances(maze, start.first, start.second);
+            REQUIRE(!path.empty());
+            CHECK(path.front() == start);
+            CHECK(path.back() == goal);
+            CHECK(isValidPath(maze, path));
+            CHECK(path.size() - 1 == reference[goal.second * maze.width + goal.first]);
+        }
+    };
+
+    SUBCASE("Paths are valid and as short as a plain breadth first search") {
+        checkQueries(cache);
+    }
+
+    SUBCASE("Parallel and serial builds agree") {
+        HPACache serial(maze, 8, 1);
+        REQUIRE(serial.clusters.size() == cache.clusters.size());
+        for (size_t c = 0; c < cache.clusters.size(); ++c) {
+            CHECK(serial.clusters[c].entrances == cache.clusters[c].entrances);
+            CHECK(serial.clusters[c].distances == cache.clusters[c].distances);
+        }
+    }
+
+    SUBCASE("Serialized cache answers the same queries") {
+        std::stringstream buffer;
+        cache.save(buffer);
+        HPACache loaded = HPACache::load(buffer);
+        CHECK(loaded.entranceCount() == cache.entranceCount());
+        checkQueries(loaded);
+
+        std::stringstream garbage("not a cache");
+        CHECK_THROWS_AS(HPACache::load(garbage), std::runtime_error);
+
+        // entrances outside their cluster, outside the maze or out of order
+        REQUIRE(cache.clusters[0].entrances.size() >= 2);
+        for (uint32_t corrupt : {uint32_t(44 * 60 + 59), uint32_t(60 * 45), cache.clusters[0].entrances[1]}) {
+            HPACache tampered = cache;
+            tampered.clusters[0].entrances[0] = corrupt;
+            std::stringstream bad;
+            tampered.save(bad);
+            CHECK_THROWS_AS(HPACache::load(bad), std::runtime_error);
+        }
+
+        // magic, then width, height and cluster size as uint64, then the entrance count of the first cluster
+        auto withField = [](std::string bytes, size_t offset, uint64_t value, size_t size) {
+            for (size_t i = 0; i < size; ++i)
+                bytes[offset + i] = static_cast<char>(value >> (8 * i));
+            return bytes;
+        };
+        std::stringstream entrances(withField(buffer.str(), 28, 4 * 8 * 8, 4));
+        CHECK_THROWS_AS(HPACache::load(entrances), std::runtime_error);
+        // billions of one cell clusters announced by a header followed by a few kilobytes
+        std::stringstream clusters(withField(withField(withField(buffer.str(), 4, 65535, 8), 12, 65535, 8), 20, 1, 8));
+        CHECK_THROWS_AS(HPACache::load(clusters), std::runtime_error);
+    }
+
+    SUBCASE("Rejects cells outside the maze") {
+        CHECK_THROWS_AS(cache.findPath(maze, {60, 0}, {0, 0}), std::invalid_argument);
+        CHECK_THROWS_AS(cache.findPath(maze, {0, 0}, {0, 45}), std::invalid_argument);
+    }
+
+    SUBCASE("Partial update after opening walls") {
+        // open a few walls across cluster borders and inside clusters, creating loops
+        std::vector<std::tuple<size_t, size_t, Direction>> changes = {
+            {7, 10, Direction::RIGHT}, {20, 15, Direction::DOWN}, {33, 33, Direction::RIGHT}, {40, 23, Direction::DOWN}, {2, 2, Direction::RIGHT}};
+        for (auto [x, y, dir] : changes) {
+            maze.setWall(x, y, dir, false);
+            cache.update(maze, x, y, dir);
+        }
+        checkQueries(cache);
+    }
+}
+
+TEST_CASE("Chunked infinite maze") {
+    SUBCASE("Chunks are deterministic") {
+        Maze a = ChunkedMaze::generateChunk(42, 16, -3, 7);
+        Maze b = ChunkedMaze::generateChunk(42, 16, -3, 7);
+        Maze c = ChunkedMaze::generateChunk(43, 16, -3, 7);
+        CHECK(a.print() == b.print());
+        CHECK(a.print() != c.print());
+    }
+
+    SUBCASE("Neighbors agree on their shared edges") {
+        const size_t size = 16;
+        for (int64_t cy = -2; cy <= 2; ++cy) {
+            for (int64_t cx = -2; cx <= 2; ++cx) {
+                Maze center = ChunkedMaze::generateChunk(7, size, cx, cy);
+                Maze right = ChunkedMaze::generateChunk(7, size, cx + 1, cy);
+                Maze below = ChunkedMaze::generateChunk(7, size, cx, cy + 1);
+                size_t openRight = 0, openBelow = 0;
+                for (size_t i = 0; i < size; ++i) {
+                    CHECK(center.isOpen(size - 1, i, Direction::RIGHT) == right.isOpen(0, i, Direction::LEFT));
+                    CHECK(center.isOpen(i, size - 1, Direction::DOWN) == below.isOpen(i, 0, Direction::UP));
+                    openRight += center.isOpen(size - 1, i, Direction::RIGHT);
+                    openBelow += center.isOpen(i, size - 1, Direction::DOWN);
+                }
+                CHECK(openRight == 1);
+                CHECK(openBelow == 1);
+            }
+        }
+    }
+
+    SUBCASE("World queries are symmetric across chunk borders") {
+        ChunkedMaze world(11, 8);
+        for (int64_t y = -20; y < 20; ++y) {
+            for (int64_t x = -20; x < 20; ++x) {
+                CHECK(world.isOpen(x, y, Direction::RIGHT) == world.isOpen(x + 1, y, Direction::LEFT));
+                CHECK(world.isOpen(x, y, Direction::DOWN) == world.isOpen(x, y + 1, Direction::UP));
+            }
+        }
+    }
+
+    SUBCASE("Cache stays inside its memory budget") {
+        ChunkedMaze world(5, 32, 4 * ChunkedMaze::chunkBytes(32));
+        CHECK(world.maxCachedChunks() == 4);
+        for (int64_t i = 0; i < 50; ++i)
+            world.isOpen(i * 32, 0, Direction::RIGHT);
+        CHECK(world.cachedChunks() == 4);
+        CHECK(world.misses == 50);
+
+        std::string before = world.chunk(49, 0).print();
+        world.isOpen(49 * 32 + 3, 5, Direction::UP);
+        CHECK(world.hits == 2);
+        CHECK(world.chunk(49, 0).print() == before);
+    }
+
+    SUBCASE("Chunks work with the flow fields") {
+        Maze chunk = ChunkedMaze::generateChunk(3, 16, 100, -100);
+        FlowField field(chunk, {{0, 0}});
+        bool reachable = true;
+        for (size_t y = 0; y < 16; ++y)
+            for (size_t x = 0; x < 16; ++x)
+                reachable = reachable && field.distance(x, y) != FlowField::Unreachable;
+        CHECK(reachable);
+    }
+}
+
+TEST_CASE("Binary maze files") {
+    Maze maze(37, 21, 4);
+    maze.generate();
+
+    SUBCASE("Write and read back") {
+        std::stringstream buffer;
+        MazeFile::write(maze, buffer);
+        CHECK(buffer.str().size() == MazeFile::fileSize(maze.width, maze.height));
+
+        Maze loaded = MazeFile::read(buffer);
+        CHECK(loaded.width == maze.width);
+        CHECK(loaded.height == maze.height);
+        CHECK(loaded.randomIndex == maze.randomIndex);
+        CHECK(loaded.print() == maze.print());
+    }
+
+    SUBCASE("Rejects other files") {
+        std::stringstream garbage("definitely not a maze file, but long enough for a header");
+        CHECK_THROWS_AS(MazeFile::read(garbage), std::runtime_error);
+
+        std::stringstream truncated;
+        MazeFile::write(maze, truncated);
+        std::stringstream half(truncated.str().substr(0, 40));
+        CHECK_THROWS_AS(MazeFile::read(half), std::runtime_error);
+    }
+
+    SUBCASE("Rejects corrupt headers") {
+        std::stringstream buffer;
+        MazeFile::write(maze, buffer);
+        auto withField = [&](size_t offset, uint64_t value) {
+            std::string bytes = buffer.str();
+            for (size_t i = 0; i < 8; ++i)
+                bytes[offset + i] = static_cast<char>(value >> (8 * i));
+            return bytes;
+        };
+        // (height + 1) * width wraps to a small file size
+        std::stringstream wrapping(withField(16, UINT64_MAX));
+        CHECK_THROWS_AS(MazeFile::read(wrapping), std::runtime_error);
+        std::stringstream wide(withField(8, uint64_t(1) << 62));
+        CHECK_THROWS_AS(MazeFile::read(wide), std::runtime_error);
+        // fits in a size_t, but the stream does not hold that many walls
+        std::stringstream huge(withField(8, uint64_t(1) << 40));
+        CHECK_THROWS_AS(MazeFile::read(huge), std::runtime_error);
+        std::stringstream index(withField(24, 300));
+        CHECK_THROWS_AS(MazeFile::read(index), std::runtime_error);
+    }
+
+    SUBCASE("Mapped file prints and solves like the original") {
+        fs::path path = fs::temp_directory_path() / "maze-tests-mapped.maze";
+        MazeFile::save(maze, path.string());
+        {
+            MappedMaze mapped(path.string());
+            CHECK(mapped.width == maze.width);
+            CHECK(mapped.height == maze.height);
+            CHECK(mapped.print() == maze.print());
+
+            FlowField fromMapped(mapped, {{36, 20}});
+            FlowField fromMaze(maze, {{36, 20}});
+            bool same = true;
+            for (size_t y = 0; y < maze.height; ++y)
+                for (size_t x = 0; x < maze.width; ++x)
+                    same = same && fromMapped.distance(x, y) == fromMaze.distance(x, y) && fromMapped.direction(0, x, y) == fromMaze.direction(0, x, y);
+            CHECK(same);
+
+            HPACache cache(mapped, 8, 1);
+            CHECK(cache.findPath(mapped, {0, 0}, {36, 20}).size() == fromMaze.distance(0, 0) + 1);
+        }
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::app);
+            out << "extra";
+        }
+        CHECK_THROWS_AS(MappedMaze(path.string()), std::runtime_error);
+        fs::remove(path);
+        CHECK_THROWS_AS(MappedMaze(path.string()), std::runtime_error);
+    }
+}
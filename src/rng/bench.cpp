@@ -0,0 +1,153 @@
+// Throughput and quality benchmark for the RNG module.
+// usage: rng-bench [buffer bytes...]   default 4096 65536 1048576 16777216 67108864
+// results are written to stdout as JSON
+#include "quality.h"
+#include "random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// the instruction set XorShiftBulk was compiled for
+static const char *bulkIsa()
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(RNG_USE_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// every generator is measured through the same signature: fill this buffer, keep your state
+using Fill = std::function<void(std::vector<uint32_t> &)>;
+
+struct Generator
+{
+    std::string name;
+    Fill fill;
+    // state bits of a generator linear over GF(2), the linear complexity its output must have. 0 otherwise
+    size_t linearStateBits = 0;
+};
+
+static std::vector<Generator> generators()
+{
+    std::vector<Generator> list;
+
+    // one xorShift chain, every value waits for the previous one
+    list.push_back({"xorShift", [seed = uint32_t(1)](std::vector<uint32_t> &out) mutable
+                    {
+                        for (uint32_t &value : out)
+                            value = seed = RNG::xorShift(seed, 0, 0);
+                    },
+                    32});
+
+    // XorShiftBulk lanes stepped one value at a time, what the bulk generator does without SIMD
+    list.push_back({"xorShiftLanes", [state = std::vector<uint32_t>()](std::vector<uint32_t> &out) mutable
+                    {
+                        if (state.empty())
+                            for (size_t i = 0; i < RNG::XorShiftBulk::Lanes; ++i)
+                                state.push_back(RNG::XorShiftBulk::laneSeed(1, i));
+                        for (size_t k = 0; k + RNG::XorShiftBulk::Lanes <= out.size(); k += RNG::XorShiftBulk::Lanes)
+                            for (size_t i = 0; i < RNG::XorShiftBulk::Lanes; ++i)
+                                out[k + i] = state[i] = RNG::XorShift32::step(state[i]);
+                    },
+                    32 * RNG::XorShiftBulk::Lanes});
+
+    // the bulk generator with the SIMD path it was compiled for
+    list.push_back({std::string("xorShiftBulk-") + bulkIsa(), [bulk = RNG::XorShiftBulk(1)](std::vector<uint32_t> &out) mutable
+                    { bulk.fill(out); },
+                    32 * RNG::XorShiftBulk::Lanes});
+
+    list.push_back({"philox4x32", [counter = uint64_t(0)](std::vector<uint32_t> &out) mutable
+                    {
+                        RNG::Philox4x32::fill(RNG::Philox4x32::key(1), counter, out);
+                        counter += (out.size() + 3) / 4;
+                    }});
+    return list;
+}
+
+// repeats the fill until it takes long enough to be measured
+static constexpr double MinimumSeconds = 0.3;
+
+static double gigabytesPerSecond(Generator &generator, size_t bytes)
+{
+    std::vector<uint32_t> buffer(std::max<size_t>(1, bytes / sizeof(uint32_t)));
+    generator.fill(buffer); // warm up, and fault the pages in
+    size_t total = 0;
+    uint32_t sink = 0;
+    auto start = Clock::now();
+    do
+    {
+        generator.fill(buffer);
+        sink ^= buffer[total % buffer.size()];
+        total += buffer.size() * sizeof(uint32_t);
+    } while (secondsSince(start) < MinimumSeconds);
+    const double seconds = secondsSince(start);
+    // keeps the compiler from dropping the fills
+    if (sink == 0x12345678u)
+        std::cerr << "";
+    return total / seconds / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::stoul(argv[i]));
+    if (sizes.empty())
+        sizes = {4096, 65536, 1048576, 16777216, 67108864};
+
+    auto list = generators();
+    std::cout << "{\n  \"benchmark\": \"rng\",\n  \"bulk_isa\": \"" << bulkIsa() << "\",\n  \"throughput\": [\n";
+    for (size_t g = 0; g < list.size(); ++g)
+    {
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            std::cerr << "measuring " << list[g].name << " with " << sizes[i] << " bytes..." << std::endl;
+            const double rate = gigabytesPerSecond(list[g], sizes[i]);
+            std::cout << "    {\"generator\": \"" << list[g].name << "\", \"buffer_bytes\": " << sizes[i]
+                      << ", \"gigabytes_per_second\": " << rate << "}"
+                      << (g + 1 < list.size() || i + 1 < sizes.size() ? ",\n" : "\n");
+            std::cout.flush();
+        }
+    }
+
+    std::cout << "  ],\n  \"quality\": [\n";
+    // fresh generators, so the battery always sees the start of every stream
+    list = generators();
+    for (size_t g = 0; g < list.size(); ++g)
+    {
+        std::cerr << "testing " << list[g].name << "..." << std::endl;
+        std::vector<uint32_t> values(1 << 20);
+        list[g].fill(values);
+        const RNG::Battery::Result results[] = {RNG::Battery::frequency(values), RNG::Battery::runs(values), RNG::Battery::birthdaySpacings(values),
+                                                RNG::Battery::linearComplexity(values, list[g].linearStateBits)};
+        for (size_t t = 0; t < std::size(results); ++t)
+        {
+            const RNG::Battery::Result &q = results[t];
+            std::cout << "    {\"generator\": \"" << list[g].name << "\", \"test\": \"" << q.test
+                      << "\", \"statistic\": " << q.statistic << ", \"p_value\": ";
+            if (q.pValue)
+                std::cout << *q.pValue;
+            else
+                std::cout << "null";
+            std::cout << ", \"passed\": " << (q.passed ? "true" : "false") << "}"
+                      << (g + 1 < list.size() || t + 1 < std::size(results) ? ",\n" : "\n");
+        }
+        std::cout.flush();
+    }
+    std::cout << "  ]\n}" << std::endl;
+    return 0;
+}
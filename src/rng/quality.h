@@ -0,0 +1,157 @@
+// Quick statistical battery for the generators of random.h, used by rng-bench
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/* Statistical battery.
+ *
+ * A few quick tests, far from TestU01 or PractRand, enough to notice when a change to a generator breaks
+ * its output. Bits are read least significant first from every value. Each test reports its statistic and
+ * whether it passed: a p-value of at least 0.001 where there is one, or the exact expected statistic where
+ * a correct generator has a known one.
+ */
+namespace RNG::Battery
+{
+    struct Result
+    {
+        std::string test;
+        double statistic;
+        // none when the statistic is checked against an exact expected value
+        std::optional<double> pValue;
+        bool passed;
+    };
+
+    inline constexpr double Significance = 0.001;
+
+    inline Result fromPValue(std::string test, double statistic, double pValue)
+    {
+        return {std::move(test), statistic, pValue, pValue >= Significance};
+    }
+
+    // p-value of a standard normal z score
+    inline double twoSidedPValue(double z)
+    {
+        return std::erfc(std::abs(z) / std::sqrt(2.0));
+    }
+
+    inline int bit(const std::vector<uint32_t> &values, size_t i)
+    {
+        return (values[i / 32] >> (i % 32)) & 1;
+    }
+
+    // ones among the first n bits
+    inline double ones(const std::vector<uint32_t> &values, size_t n)
+    {
+        double count = 0;
+        for (size_t i = 0; i < n / 32; ++i)
+            count += std::popcount(values[i]);
+        if (n % 32)
+            count += std::popcount(values[n / 32] & ((uint32_t(1) << (n % 32)) - 1));
+        return count;
+    }
+
+    // monobit frequency: the share of ones over all bits, as a normal z score
+    inline Result frequency(const std::vector<uint32_t> &values)
+    {
+        const double n = 32.0 * values.size();
+        const double z = (ones(values, values.size() * 32) - n / 2) / std::sqrt(n / 4);
+        return fromPValue("frequency", z, twoSidedPValue(z));
+    }
+
+    /* NIST SP 800-22 runs test over the first n bits, all of them by default: the number of maximal blocks
+     * of equal bits V, whose mean is 2 n pi (1 - pi) for a share pi of ones and whose standard deviation is
+     * 2 sqrt(n) pi (1 - pi). NIST first checks |pi - 1/2| < 2 / sqrt(n); a sequence that fails the frequency
+     * check fails the runs test too, reported with statistic 0 and p-value 0.
+     */
+    inline Result runs(const std::vector<uint32_t> &values, size_t n = 0)
+    {
+        if (n == 0)
+            n = 32 * values.size();
+        const double pi = ones(values, n) / n;
+        if (!(std::abs(pi - 0.5) < 2 / std::sqrt(double(n))))
+            return fromPValue("runs", 0, 0);
+        double count = 1;
+        for (size_t i = 1; i < n; ++i)
+            count += bit(values, i) != bit(values, i - 1);
+        const double expected = 2.0 * n * pi * (1 - pi);
+        const double z = (count - expected) / (2.0 * std::sqrt(double(n)) * pi * (1 - pi));
+        return fromPValue("runs", z, twoSidedPValue(z));
+    }
+
+    /* Marsaglia's birthday spacings: 2^10 birthdays taken from the top 24 bits in a year of 2^24 days. The
+     * number of repeated spacings is Poisson with mean 2^30 / 2^26 = 16, summed over many years.
+     */
+    inline Result birthdaySpacings(const std::vector<uint32_t> &values)
+    {
+        constexpr size_t Birthdays = 1024;
+        constexpr double Lambda = 16;
+        const size_t years = values.size() / Birthdays;
+        double repeats = 0;
+        std::vector<uint32_t> days(Birthdays), spacings(Birthdays);
+        for (size_t year = 0; year < years; ++year)
+        {
+            for (size_t i = 0; i < Birthdays; ++i)
+                days[i] = values[year * Birthdays + i] >> 8;
+            std::sort(days.begin(), days.end());
+            spacings[0] = days[0];
+            for (size_t i = 1; i < Birthdays; ++i)
+                spacings[i] = days[i] - days[i - 1];
+            std::sort(spacings.begin(), spacings.end());
+            for (size_t i = 1; i < Birthdays; ++i)
+                repeats += spacings[i] == spacings[i - 1];
+        }
+        const double mean = Lambda * years;
+        const double z = (repeats - mean) / std::sqrt(mean);
+        return fromPValue("birthday_spacings", z, twoSidedPValue(z));
+    }
+
+    /* Linear complexity of the sequence made by the lowest bit of every value, with Berlekamp-Massey.
+     *
+     * For a random sequence of n bits it is n / 2 give or take a couple of bits. Generators that are linear
+     * over GF(2), like xorshift, have exactly the size of their state instead, the degree of their primitive
+     * characteristic polynomial: pass it as linearStateBits and the test checks that value. Anything else
+     * means the recurrence changed.
+     */
+    inline Result linearComplexity(const std::vector<uint32_t> &values, size_t linearStateBits = 0)
+    {
+        const size_t n = std::min<size_t>(values.size(), 4000);
+        std::vector<uint8_t> s(n), c(n + 1, 0), b(n + 1, 0), t;
+        for (size_t i = 0; i < n; ++i)
+            s[i] = values[i] & 1;
+        c[0] = b[0] = 1;
+        size_t length = 0;
+        ptrdiff_t m = -1;
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint8_t d = s[i];
+            for (size_t j = 1; j <= length; ++j)
+                d ^= c[j] & s[i - j];
+            if (d == 0)
+                continue;
+            t = c;
+            for (size_t j = 0; j + i - m <= n; ++j)
+                c[j + i - m] ^= b[j];
+            if (2 * length <= i)
+            {
+                length = i + 1 - length;
+                m = static_cast<ptrdiff_t>(i);
+                b = t;
+            }
+        }
+        if (linearStateBits > 0 && 2 * linearStateBits < n)
+            return {"linear_complexity", double(length), std::nullopt, length == linearStateBits};
+        // the deviation from n / 2 has variance close to 86 / 81, treat it as normal
+        const double z = (double(length) - n / 2.0) / std::sqrt(86.0 / 81.0);
+        return fromPValue("linear_complexity", double(length), twoSidedPValue(z));
+    }
+}
+
+#endif
@@ -2,11 +2,777 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RNG_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/* The Portable functions and the samplers built on them only give the same bits everywhere if every
+ * operation is rounded on its own, without contracting a + b * c into a fused multiply add.
+ *
+ * Clang fuses within an expression by default (-ffp-contract=on). This pragma, placed at the top of a
+ * block, turns that off until the end of the block.
+ *
+ * GCC has no such pragma. In the gnu++ modes, its default, it fuses across statements (-ffp-contract=fast)
+ * as soon as the target has FMA, for example with -march=native. Code using these samplers must be built
+ * with -ffp-contract=off, as the targets of this module are.
+ *
+ * MSVC only fuses with /fp:contract or /fp:fast.
+ */
+#if defined(__clang__)
+#define RNG_NO_FP_CONTRACT _Pragma("STDC FP_CONTRACT OFF")
+#else
+#define RNG_NO_FP_CONTRACT
+#endif
+
 namespace RNG
 {
-    unsigned int xorShift(unsigned int seed, int r1, int r2)
+    // 32x32 bit matrices over GF(2), stored as 32 columns: column j is the image of the vector with
+    // only bit j set
+    namespace GF2
+    {
+        using Matrix = std::array<uint32_t, 32>;
+
+        constexpr uint32_t apply(const Matrix &m, uint32_t v)
+        {
+            uint32_t result = 0;
+            for (size_t j = 0; j < 32; ++j)
+                if ((v >> j) & 1)
+                    result ^= m[j];
+            return result;
+        }
+
+        constexpr Matrix multiply(const Matrix &a, const Matrix &b)
+        {
+            Matrix result{};
+            for (size_t j = 0; j < 32; ++j)
+                result[j] = apply(a, b[j]);
+            return result;
+        }
+
+        // the matrix of one xorshift step with shifts left a, right b, left c
+        constexpr Matrix xorShiftStep(int a, int b, int c)
+        {
+            Matrix m{};
+            for (size_t j = 0; j < 32; ++j)
+            {
+                uint32_t value = uint32_t(1) << j;
+                value ^= value << a;
+                value ^= value >> b;
+                value ^= value << c;
+                m[j] = value;
+            }
+            return m;
+        }
+
+        // m^1, m^2, m^4, ... m^(2^63)
+        constexpr std::array<Matrix, 64> powersOfTwo(const Matrix &m)
+        {
+            std::array<Matrix, 64> powers{};
+            powers[0] = m;
+            for (size_t k = 1; k < 64; ++k)
+                powers[k] = multiply(powers[k - 1], powers[k - 1]);
+            return powers;
+        }
+    }
+
+    /* Marsaglia xorshift32 with the shift triple fixed at compile time.
+     *
+     * The shifts are template arguments, so they are immediates in the generated code and whole chains
+     * fold to constants when the seed is known. Everything is constexpr, so it also runs in consteval
+     * code, see xorShiftTable(). It satisfies std::uniform_random_bit_generator and plugs straight into
+     * the <random> distributions.
+     *
+     * Only triples with a full period of 2^32 - 1 are useful, Marsaglia lists all 81 of them. (13, 17, 5)
+     * is the one used by xorShift() and the fixtures.
+     */
+    template <int A, int B, int C>
+    struct XorShift
+    {
+        static_assert(A > 0 && A < 32 && B > 0 && B < 32 && C > 0 && C < 32, "xorshift shifts must be in 1..31");
+
+        using result_type = uint32_t;
+
+        // zero is a fixed point, the generator never reaches it from any other state
+        static constexpr result_type min() { return 1; }
+        static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+        // a zero seed would only ever produce zeros, so it is replaced like XorShiftBulk::laneSeed does
+        constexpr explicit XorShift(uint32_t seed = 2463534242u) : state(seed != 0 ? seed : 0x6D2B79F5u) {}
+
+        // one step from value, the same computation as xorShift() for the (13, 17, 5) triple
+        static constexpr uint32_t step(uint32_t value)
+        {
+            value ^= value << A;
+            value ^= value >> B;
+            value ^= value << C;
+            return value;
+        }
+
+        constexpr result_type next() { return state = step(state); }
+        constexpr result_type operator()() { return next(); }
+
+        // skips n values in O(log n), see XorShiftJump
+        constexpr void discard(uint64_t n) { state = jump(state, n); }
+
+        // the state after steps calls of step(), starting from state
+        static constexpr uint32_t jump(uint32_t state, uint64_t steps)
+        {
+            for (size_t k = 0; steps != 0; ++k, steps >>= 1)
+                if (steps & 1)
+                    state = GF2::apply(powers[k], state);
+            return state;
+        }
+
+        constexpr bool operator==(const XorShift &) const = default;
+
+        uint32_t state;
+
+    private:
+        // only built when discard() or jump() are used for this triple
+        static constexpr std::array<GF2::Matrix, 64> powers = GF2::powersOfTwo(GF2::xorShiftStep(A, B, C));
+    };
+
+    // the generator behind xorShift() and the fixtures
+    using XorShift32 = XorShift<13, 17, 5>;
+
+    // the first N values after seed, computed at compile time when used in a constant expression
+    template <size_t N, typename Generator = XorShift32>
+    constexpr std::array<uint32_t, N> xorShiftTable(uint32_t seed)
+    {
+        Generator generator(seed);
+        std::array<uint32_t, N> table{};
+        for (auto &value : table)
+            value = generator();
+        return table;
+    }
+
+    // Marsaglia xorshift32 with the (13, 17, 5) triple. r1 and r2 are the range the caller will clamp
+    // to, they do not change the raw value returned
+    inline unsigned int xorShift(unsigned int seed, int r1, int r2)
+    {
+        (void)r1;
+        (void)r2;
+        return XorShift32::step(seed);
+    }
+
+    /* Bulk generation with independent xorshift32 lanes.
+     *
+     * A single xorshift stream is a serial chain, every value depends on the previous one. Here there are
+     * Lanes streams advanced side by side, which maps to two AVX2 registers or four SSE2 registers, and
+     * the output interleaves them: out[k * Lanes + i] is the k-th value of lane i.
+     *
+     * Lane i starts from laneSeed(seed, i), a bijective 32 bit mix of seed + i * 0x9E3779B9, so lanes are
+     * decorrelated even for consecutive seeds. Each lane then follows xorShift() exactly. The result only
+     * depends on the seed and on how many values were drawn, never on the instruction set in use or on
+     * how the draws were split between calls to fill().
+     */
+    struct XorShiftBulk
+    {
+        static constexpr size_t Lanes = 16;
+
+        // murmur3 finalizer. zero is a fixed point of xorshift, so it is replaced
+        static uint32_t laneSeed(uint32_t seed, size_t lane)
+        {
+            uint32_t h = seed + static_cast<uint32_t>(lane) * 0x9E3779B9u;
+            h ^= h >> 16;
+            h *= 0x85EBCA6Bu;
+            h ^= h >> 13;
+            h *= 0xC2B2AE35u;
+            h ^= h >> 16;
+            return h != 0 ? h : 0x6D2B79F5u;
+        }
+
+        explicit XorShiftBulk(uint32_t seed)
+        {
+            for (size_t i = 0; i < Lanes; ++i)
+                state[i] = laneSeed(seed, i);
+        }
+
+        void fill(std::span<uint32_t> out)
+        {
+            size_t n = 0;
+            // values left over from the last partial block come first
+            while (n < out.size() && buffered < Lanes)
+                out[n++] = buffer[buffered++];
+
+            const size_t blocks = (out.size() - n) / Lanes;
+            nextBlocks(out.data() + n, blocks);
+            n += blocks * Lanes;
+
+            if (n < out.size())
+            {
+                nextBlocks(buffer, 1);
+                buffered = 0;
+                while (n < out.size())
+                    out[n++] = buffer[buffered++];
+            }
+        }
+
+        // one value at a time, so the bulk generator also works with bounded() and <random>
+        using result_type = uint32_t;
+        static constexpr result_type min() { return 1; }
+        static constexpr result_type max() { return 0xFFFFFFFFu; }
+        result_type operator()()
+        {
+            if (buffered == Lanes)
+            {
+                nextBlocks(buffer, 1);
+                buffered = 0;
+            }
+            return buffer[buffered++];
+        }
+
+        alignas(32) uint32_t state[Lanes];
+
+    private:
+        alignas(32) uint32_t buffer[Lanes] = {};
+        size_t buffered = Lanes;
+
+        // advances every lane blocks times, writing Lanes values per block
+        void nextBlocks(uint32_t *out, size_t blocks)
+        {
+#if defined(__AVX2__)
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(state));
+            __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i *>(state + 8));
+            for (size_t k = 0; k < blocks; ++k)
+            {
+                a = _mm256_xor_si256(a, _mm256_slli_epi32(a, 13));
+                b = _mm256_xor_si256(b, _mm256_slli_epi32(b, 13));
+                a = _mm256_xor_si256(a, _mm256_srli_epi32(a, 17));
+                b = _mm256_xor_si256(b, _mm256_srli_epi32(b, 17));
+                a = _mm256_xor_si256(a, _mm256_slli_epi32(a, 5));
+                b = _mm256_xor_si256(b, _mm256_slli_epi32(b, 5));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + k * Lanes), a);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + k * Lanes + 8), b);
+            }
+            _mm256_store_si256(reinterpret_cast<__m256i *>(state), a);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(state + 8), b);
+#elif defined(RNG_USE_SSE2)
+            __m128i v[4];
+            for (size_t r = 0; r < 4; ++r)
+                v[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(state + 4 * r));
+            for (size_t k = 0; k < blocks; ++k)
+            {
+                for (size_t r = 0; r < 4; ++r)
+                {
+                    v[r] = _mm_xor_si128(v[r], _mm_slli_epi32(v[r], 13));
+                    v[r] = _mm_xor_si128(v[r], _mm_srli_epi32(v[r], 17));
+                    v[r] = _mm_xor_si128(v[r], _mm_slli_epi32(v[r], 5));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + k * Lanes + 4 * r), v[r]);
+                }
+            }
+            for (size_t r = 0; r < 4; ++r)
+                _mm_store_si128(reinterpret_cast<__m128i *>(state + 4 * r), v[r]);
+#else
+            for (size_t k = 0; k < blocks; ++k)
+            {
+                for (size_t i = 0; i < Lanes; ++i)
+                {
+                    state[i] = XorShift32::step(state[i]);
+                    out[k * Lanes + i] = state[i];
+                }
+            }
+#endif
+        }
+    };
+
+    // fills out with the bulk stream of the given seed, see XorShiftBulk
+    inline void xorShiftFill(uint32_t seed, std::span<uint32_t> out)
+    {
+        XorShiftBulk(seed).fill(out);
+    }
+
+    /* Jump ahead for xorShift.
+     *
+     * Every xorshift step is linear over GF(2): the new state is T * state for a 32x32 bit matrix T.
+     * Advancing n steps is T^n * state, so with T^1, T^2, T^4, ... T^(2^63) precomputed at compile time a
+     * jump applies one matrix per set bit of n, O(log n) instead of n steps.
+     */
+    struct XorShiftJump
+    {
+        // the state after calling xorShift steps times starting from state
+        static constexpr uint32_t jump(uint32_t state, uint64_t steps)
+        {
+            return XorShift32::jump(state, steps);
+        }
+    };
+
+    // state after steps calls of xorShift, see XorShiftJump
+    inline uint32_t xorShiftJump(uint32_t state, uint64_t steps)
+    {
+        return XorShiftJump::jump(state, steps);
+    }
+
+    // period of xorShift for any nonzero seed
+    inline constexpr uint64_t XorShiftPeriod = 0xFFFFFFFFull;
+
+    /* Splits one xorShift stream in contiguous, non-overlapping substreams.
+     *
+     * Worker k gets the state reached after k * valuesPerWorker steps, so chaining xorShift from it
+     * valuesPerWorker times yields exactly values [k * valuesPerWorker, (k + 1) * valuesPerWorker) of the
+     * stream that starts at seed, no matter how many workers run or in which order.
+     */
+    inline std::vector<uint32_t> xorShiftPartition(uint32_t seed, size_t workers, uint64_t valuesPerWorker)
+    {
+        if (workers != 0 && valuesPerWorker > XorShiftPeriod / workers)
+            throw std::invalid_argument("xorShiftPartition: substreams would wrap around the period");
+        std::vector<uint32_t> starts(workers);
+        // every boundary is valuesPerWorker past the previous one, so chain the jumps
+        uint32_t state = seed;
+        for (size_t k = 0; k < workers; ++k)
+        {
+            starts[k] = state;
+            state = XorShiftJump::jump(state, valuesPerWorker);
+        }
+        return starts;
+    }
+
+    /* Bounded integers.
+     *
+     * Lemire maps a 32 bit value x to [0, range) with the high half of x * range: one multiply instead of a
+     * divide. Taken alone that keeps the bias of %, some results get one more preimage than others, so
+     * the values whose low half falls under 2^32 mod range are rejected and drawn again. The threshold
+     * needs a division, but it is only computed when the low half is smaller than range, which happens
+     * with probability range / 2^32.
+     *
+     * Modulo is the README formula, random % range. It is biased and divides on every call, but it is what
+     * the fixtures and the maze generator are specified with, so it stays available to reproduce them.
+     */
+    enum class Bounded
+    {
+        Lemire,
+        Modulo
+    };
+
+    // a value in [0, range) from generator, range 0 means the whole 32 bit range
+    template <Bounded Mode = Bounded::Lemire, std::uniform_random_bit_generator Generator>
+    constexpr uint32_t bounded(Generator &generator, uint32_t range)
+    {
+        static_assert(Generator::max() == 0xFFFFFFFFu, "bounded() needs a 32 bit generator");
+        uint32_t x = static_cast<uint32_t>(generator());
+        if (range == 0)
+            return x;
+        if constexpr (Mode == Bounded::Modulo)
+        {
+            return x % range;
+        }
+        else
+        {
+            uint64_t m = uint64_t(x) * range;
+            uint32_t low = static_cast<uint32_t>(m);
+            if (low < range)
+            {
+                const uint32_t threshold = (0u - range) % range;
+                while (low < threshold)
+                {
+                    m = uint64_t(static_cast<uint32_t>(generator())) * range;
+                    low = static_cast<uint32_t>(m);
+                }
+            }
+            return static_cast<uint32_t>(m >> 32);
+        }
+    }
+
+    // a value between r1 and r2, both inclusive and in any order, like the README clamp
+    template <Bounded Mode = Bounded::Lemire, std::uniform_random_bit_generator Generator>
+    constexpr int32_t boundedRange(Generator &generator, int32_t r1, int32_t r2)
     {
-        // todo implement here
+        const int32_t low = r1 < r2 ? r1 : r2, high = r1 < r2 ? r2 : r1;
+        // wraps to 0 for the full int32 range, which bounded() takes as the whole 32 bit range
+        const uint32_t range = static_cast<uint32_t>(high) - static_cast<uint32_t>(low) + 1;
+        return static_cast<int32_t>(static_cast<uint32_t>(low) + bounded<Mode>(generator, range));
     }
+
+    /* Fills out with values in [0, range) drawn from the bulk generator.
+     *
+     * The raw values come from one XorShiftBulk::fill() and the rejection threshold is computed once for
+     * the whole batch, so the loop is a multiply and a compare per value. The rare rejected values are
+     * redrawn from the same generator, so a seed and a sequence of sizes always give the same output.
+     */
+    template <Bounded Mode = Bounded::Lemire>
+    void boundedFill(XorShiftBulk &bulk, std::span<uint32_t> out, uint32_t range)
+    {
+        bulk.fill(out);
+        if (range == 0)
+            return;
+        if constexpr (Mode == Bounded::Modulo)
+        {
+            for (uint32_t &value : out)
+                value %= range;
+        }
+        else
+        {
+            const uint32_t threshold = (0u - range) % range;
+            for (uint32_t &value : out)
+            {
+                uint64_t m = uint64_t(value) * range;
+                while (static_cast<uint32_t>(m) < threshold)
+                    m = uint64_t(bulk()) * range;
+                value = static_cast<uint32_t>(m >> 32);
+            }
+        }
+    }
+
+    /* Elementary functions with the same result on every compiler and standard library.
+     *
+     * std::exp and std::log are not constexpr and their last bit differs between libm implementations,
+     * which is enough to change which branch a sampler takes. These only use IEEE double arithmetic, so
+     * they give the same bits in constant expressions and at runtime, provided nothing is contracted into
+     * fused multiply adds (see RNG_NO_FP_CONTRACT: Clang is handled here, GCC needs -ffp-contract=off).
+     * Accurate to a couple of ulps over the ranges the samplers use.
+     */
+    namespace Portable
+    {
+        inline constexpr double Ln2 = 0.6931471805599453094;
+
+        constexpr double sqrt(double x)
+        {
+            RNG_NO_FP_CONTRACT
+            if (x <= 0)
+                return 0;
+            double y = x > 1 ? x : 1;
+            // Newton from above decreases monotonically, stop when it does not anymore
+            for (int i = 0; i < 2048; ++i)
+            {
+                double next = 0.5 * (y + x / y);
+                if (next >= y)
+                    break;
+                y = next;
+            }
+            return y;
+        }
+
+        constexpr double exp(double x)
+        {
+            RNG_NO_FP_CONTRACT
+            if (x < -745)
+                return 0;
+            // x = k ln2 + r with |r| <= ln2 / 2, then exp(x) = 2^k exp(r)
+            const double kf = x / Ln2 + (x < 0 ? -0.5 : 0.5);
+            const int k = static_cast<int>(kf);
+            const double r = x - k * Ln2;
+            double term = 1, sum = 1;
+            for (int n = 1; n < 24; ++n)
+            {
+                term *= r / n;
+                sum += term;
+            }
+            for (int i = 0; i < k; ++i)
+                sum *= 2;
+            for (int i = 0; i > k; --i)
+                sum *= 0.5;
+            return sum;
+        }
+
+        constexpr double log(double x)
+        {
+            RNG_NO_FP_CONTRACT
+            if (x <= 0)
+                return -std::numeric_limits<double>::infinity();
+            // x = m 2^e with m in [sqrt(1/2), sqrt(2)), then log(x) = e ln2 + 2 atanh((m - 1) / (m + 1))
+            int e = 0;
+            while (x >= 1.4142135623730951)
+            {
+                x *= 0.5;
+                ++e;
+            }
+            while (x < 0.7071067811865476)
+            {
+                x *= 2;
+                --e;
+            }
+            const double s = (x - 1) / (x + 1), s2 = s * s;
+            double term = s, sum = 0;
+            for (int n = 1; n < 60; n += 2)
+            {
+                sum += term / n;
+                term *= s2;
+            }
+            return e * Ln2 + 2 * sum;
+        }
+    }
+
+    /* Uniform reals from raw bits.
+     *
+     * The top 24 (float) or 53 (double) bits of the draw are scaled by an exact power of two. There is no
+     * division and no rounding, so every output is one of the 2^24 or 2^53 evenly spaced values in [0, 1)
+     * and the same bits give the same real everywhere.
+     */
+    constexpr float toUnitFloat(uint32_t bits) { return static_cast<float>(bits >> 8) * 0x1.0p-24f; }
+    constexpr double toUnitDouble(uint64_t bits) { return static_cast<double>(bits >> 11) * 0x1.0p-53; }
+
+    // a float or a double in [0, 1). doubles take two 32 bit draws
+    template <std::floating_point Real = double, std::uniform_random_bit_generator Generator>
+    constexpr Real uniform(Generator &generator)
+    {
+        static_assert(Generator::max() == 0xFFFFFFFFu, "uniform() needs a 32 bit generator");
+        if constexpr (sizeof(Real) <= sizeof(float))
+        {
+            return toUnitFloat(static_cast<uint32_t>(generator()));
+        }
+        else
+        {
+            const uint64_t high = static_cast<uint32_t>(generator());
+            return static_cast<Real>(toUnitDouble(high << 32 | static_cast<uint32_t>(generator())));
+        }
+    }
+
+    template <std::floating_point Real>
+    void uniformFill(XorShiftBulk &bulk, std::span<Real> out)
+    {
+        for (Real &value : out)
+            value = uniform<Real>(bulk);
+    }
+
+    // the ziggurat tables for 128 boxes, see Ziggurat
+    struct ZigguratTables
+    {
+        static constexpr size_t Boxes = 128;
+        // right edge of the base box and the area of every box
+        static constexpr double R = 3.442619855899;
+        static constexpr double Area = 9.91256303526217e-3;
+
+        // k: |hz| under k[i] is inside the box without further checks
+        std::array<uint32_t, Boxes> k{};
+        // w: scale from the signed 32 bit draw to x
+        std::array<double, Boxes> w{};
+        // f: density at the right edge of every box
+        std::array<double, Boxes> f{};
+
+        static constexpr ZigguratTables build()
+        {
+            RNG_NO_FP_CONTRACT
+            ZigguratTables t;
+            const double scale = 2147483648.0;
+            double d = R, previous = R;
+            const double q = Area / Portable::exp(-0.5 * d * d);
+            t.k[0] = static_cast<uint32_t>((d / q) * scale);
+            t.k[1] = 0;
+            t.w[0] = q / scale;
+            t.w[Boxes - 1] = d / scale;
+            t.f[0] = 1;
+            t.f[Boxes - 1] = Portable::exp(-0.5 * d * d);
+            for (size_t i = Boxes - 2; i >= 1; --i)
+            {
+                d = Portable::sqrt(-2 * Portable::log(Area / d + Portable::exp(-0.5 * d * d)));
+                t.k[i + 1] = static_cast<uint32_t>((d / previous) * scale);
+                previous = d;
+                t.f[i] = Portable::exp(-0.5 * d * d);
+                t.w[i] = d / scale;
+            }
+            return t;
+        }
+    };
+
+    /* Standard normal sampling with the Marsaglia and Tsang ziggurat.
+     *
+     * The density is covered by 128 stacked boxes of equal area. A draw picks a box with 7 bits and a
+     * signed position with the whole 32 bit value, and in about 99% of cases the point is inside the part
+     * of the box that is under the curve: one table lookup, one compare and one multiply. The rest falls
+     * back to the exact test on the wedge, or to sampling the tail beyond R.
+     *
+     * The tables are built at compile time with the Portable functions, so they are identical on every
+     * compiler, and so is the sampling as long as it is not contracted into fused multiply adds, see
+     * RNG_NO_FP_CONTRACT.
+     */
+    struct Ziggurat
+    {
+        static constexpr size_t Boxes = ZigguratTables::Boxes;
+        static constexpr double R = ZigguratTables::R;
+
+        static constexpr ZigguratTables tables = ZigguratTables::build();
+
+        template <std::uniform_random_bit_generator Generator>
+        static constexpr double sample(Generator &generator)
+        {
+            return sample(generator, static_cast<uint32_t>(generator()));
+        }
+
+        // same as above with the first draw already made, the generator is only used if it misses
+        template <std::uniform_random_bit_generator Generator>
+        static constexpr double sample(Generator &generator, uint32_t bits)
+        {
+            const int32_t hz = static_cast<int32_t>(bits);
+            const size_t iz = bits & (Boxes - 1);
+            if (magnitude(hz) < tables.k[iz])
+                return hz * tables.w[iz];
+            return slow(generator, hz, iz);
+        }
+
+    private:
+        static constexpr uint32_t magnitude(int32_t hz)
+        {
+            return hz < 0 ? 0u - static_cast<uint32_t>(hz) : static_cast<uint32_t>(hz);
+        }
+
+        template <std::uniform_random_bit_generator Generator>
+        static constexpr double slow(Generator &generator, int32_t hz, size_t iz)
+        {
+            RNG_NO_FP_CONTRACT
+            while (true)
+            {
+                if (iz == 0)
+                {
+                    // the tail beyond R, Marsaglia's exponential method. 1 - u keeps the log argument above 0
+                    double x, y;
+                    do
+                    {
+                        x = -Portable::log(1 - uniform<double>(generator)) / R;
+                        y = -Portable::log(1 - uniform<double>(generator));
+                    } while (y + y < x * x);
+                    return hz > 0 ? R + x : -R - x;
+                }
+
+                const double x = hz * tables.w[iz];
+                if (tables.f[iz] + uniform<double>(generator) * (tables.f[iz - 1] - tables.f[iz]) < Portable::exp(-0.5 * x * x))
+                    return x;
+
+                hz = static_cast<int32_t>(static_cast<uint32_t>(generator()));
+                iz = static_cast<uint32_t>(hz) & (Boxes - 1);
+                if (magnitude(hz) < tables.k[iz])
+                    return hz * tables.w[iz];
+            }
+        }
+    };
+
+    // a normal value with the given mean and standard deviation
+    template <std::floating_point Real = double, std::uniform_random_bit_generator Generator>
+    constexpr Real normal(Generator &generator, Real mean = 0, Real stddev = 1)
+    {
+        RNG_NO_FP_CONTRACT
+        return mean + stddev * static_cast<Real>(Ziggurat::sample(generator));
+    }
+
+    /* Fills out with normal values drawn from the bulk generator.
+     *
+     * The raw bits come in blocks from XorShiftBulk::fill() and go through the ziggurat fast path, only
+     * the rare draws that miss it take extra values from the generator.
+     */
+    template <std::floating_point Real>
+    void normalFill(XorShiftBulk &bulk, std::span<Real> out, Real mean = 0, Real stddev = 1)
+    {
+        RNG_NO_FP_CONTRACT
+        constexpr size_t Block = 256;
+        alignas(32) uint32_t bits[Block];
+        for (size_t start = 0; start < out.size(); start += Block)
+        {
+            const size_t count = std::min(Block, out.size() - start);
+            bulk.fill(std::span<uint32_t>(bits, count));
+            for (size_t i = 0; i < count; ++i)
+                out[start + i] = mean + stddev * static_cast<Real>(Ziggurat::sample(bulk, bits[i]));
+        }
+    }
+
+    /* Philox4x32-10, the counter based generator of Salmon et al. (Random123).
+     *
+     * There is no state: a 128 bit counter and a 64 bit key go through 10 rounds of multiplies and xors
+     * and come out as 128 random bits. Value number n of stream key is block(counter n, key), so any value
+     * can be computed directly, in any order and on any thread. A typical use is one key per run and the
+     * counter {draw, 0, agent, frame}, see Stream.
+     *
+     * The output matches the Random123 known answers, and so std::philox4x32 from C++26.
+     */
+    struct Philox4x32
+    {
+        using Counter = std::array<uint32_t, 4>;
+        using Key = std::array<uint32_t, 2>;
+
+        static constexpr uint32_t M0 = 0xD2511F53u, M1 = 0xCD9E8D57u;
+        // Weyl sequence bumping the key between rounds
+        static constexpr uint32_t W0 = 0x9E3779B9u, W1 = 0xBB67AE85u;
+        static constexpr int Rounds = 10;
+
+        static constexpr Counter block(Counter counter, Key key)
+        {
+            for (int round = 0; round < Rounds; ++round)
+            {
+                if (round > 0)
+                {
+                    key[0] += W0;
+                    key[1] += W1;
+                }
+                const uint64_t product0 = uint64_t(M0) * counter[0];
+                const uint64_t product1 = uint64_t(M1) * counter[2];
+                counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0], static_cast<uint32_t>(product1),
+                           static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1], static_cast<uint32_t>(product0)};
+            }
+            return counter;
+        }
+
+        // the key of a 64 bit seed
+        static constexpr Key key(uint64_t seed) { return {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}; }
+
+        /* Fills out with the blocks of counters first, first + 1, ... on the low 64 bits of the counter,
+         * high word fixed. Blocks do not depend on each other, so ranges of it can be handed to different
+         * threads with the same result.
+         */
+        static void fill(Key key, uint64_t first, std::span<uint32_t> out, uint64_t high = 0)
+        {
+            const size_t blocks = out.size() / 4;
+            for (size_t b = 0; b < blocks; ++b)
+            {
+                const Counter values = block(counterOf(first + b, high), key);
+                for (size_t i = 0; i < 4; ++i)
+                    out[4 * b + i] = values[i];
+            }
+            if (blocks * 4 < out.size())
+            {
+                const Counter values = block(counterOf(first + blocks, high), key);
+                for (size_t i = 0; blocks * 4 + i < out.size(); ++i)
+                    out[blocks * 4 + i] = values[i];
+            }
+        }
+
+        static constexpr Counter counterOf(uint64_t low, uint64_t high)
+        {
+            return {static_cast<uint32_t>(low), static_cast<uint32_t>(low >> 32), static_cast<uint32_t>(high), static_cast<uint32_t>(high >> 32)};
+        }
+
+        /* A uniform_random_bit_generator reading one stream of blocks, for bounded(), uniform(), normal()
+         * and the <random> distributions. The stream of agent i at frame t is Stream(key, i, t): agent and
+         * frame fill the high word of the counter and draws count up the low word, so streams of different
+         * agents or frames never share a block. It only depends on those three values, not on what other
+         * agents or threads drew.
+         */
+        struct Stream
+        {
+            using result_type = uint32_t;
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+            constexpr Stream(Key key, uint32_t agent, uint32_t frame = 0) : key(key), high(uint64_t(frame) << 32 | agent) {}
+
+            constexpr result_type operator()()
+            {
+                if (used == 4)
+                {
+                    values = block(counterOf(next++, high), key);
+                    used = 0;
+                }
+                return values[used++];
+            }
+
+        private:
+            Key key;
+            uint64_t high;
+            uint64_t next = 0;
+            Counter values{};
+            size_t used = 4;
+        };
+    };
 }
 #endif
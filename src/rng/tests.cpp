@@ -2,12 +2,18 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
+#include "quality.h"
 #include "random.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <concepts>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <random>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -190,3 +196,481 @@ TEST_CASE("RNG file-based fixtures")
     }
   }
 }
+
+TEST_CASE("RNG bulk generation")
+{
+  SUBCASE("Scalar xorShift matches the README example")
+  {
+    CHECK(RNG::xorShift(1, 0, 99) == 270369u);
+  }
+
+  SUBCASE("Every lane follows the scalar xorShift chain")
+  {
+    const uint32_t seed = 12345;
+    std::vector<uint32_t> bulk(RNG::XorShiftBulk::Lanes * 100);
+    RNG::xorShiftFill(seed, bulk);
+    for (size_t lane = 0; lane < RNG::XorShiftBulk::Lanes; ++lane)
+    {
+      uint32_t value = RNG::XorShiftBulk::laneSeed(seed, lane);
+      for (size_t k = 0; k < 100; ++k)
+      {
+        value = RNG::xorShift(value, 0, 0);
+        REQUIRE(bulk[k * RNG::XorShiftBulk::Lanes + lane] == value);
+      }
+    }
+  }
+
+  SUBCASE("Splitting the draws between calls does not change the stream")
+  {
+    std::vector<uint32_t> whole(1000);
+    RNG::xorShiftFill(7, whole);
+
+    RNG::XorShiftBulk bulk(7);
+    std::vector<uint32_t> pieces(1000);
+    size_t sizes[] = {1, 3, 16, 17, 100, 5, 858};
+    size_t offset = 0;
+    for (size_t size : sizes)
+    {
+      bulk.fill(std::span<uint32_t>(pieces).subspan(offset, size));
+      offset += size;
+    }
+    REQUIRE(offset == pieces.size());
+    CHECK(pieces == whole);
+  }
+
+  SUBCASE("Lane seeds are never zero and differ between lanes")
+  {
+    for (uint32_t seed : {0u, 1u, 0xFFFFFFFFu})
+    {
+      for (size_t i = 0; i < RNG::XorShiftBulk::Lanes; ++i)
+      {
+        CHECK(RNG::XorShiftBulk::laneSeed(seed, i) != 0u);
+        for (size_t j = 0; j < i; ++j)
+          CHECK(RNG::XorShiftBulk::laneSeed(seed, i) != RNG::XorShiftBulk::laneSeed(seed, j));
+      }
+    }
+  }
+}
+
+TEST_CASE("RNG jump ahead")
+{
+  SUBCASE("Jumping matches stepping one value at a time")
+  {
+    for (uint32_t seed : {1u, 42u, 0xDEADBEEFu})
+    {
+      uint32_t value = seed;
+      for (uint64_t n = 0; n <= 2000; ++n)
+      {
+        REQUIRE(RNG::xorShiftJump(seed, n) == value);
+        value = RNG::xorShift(value, 0, 0);
+      }
+    }
+  }
+
+  SUBCASE("Jumps compose and wrap around the period")
+  {
+    const uint32_t seed = 987654321u;
+    CHECK(RNG::xorShiftJump(seed, RNG::XorShiftPeriod) == seed);
+    CHECK(RNG::xorShiftJump(seed, RNG::XorShiftPeriod + 10) == RNG::xorShiftJump(seed, 10));
+    CHECK(RNG::xorShiftJump(RNG::xorShiftJump(seed, 123456789), 987654321) == RNG::xorShiftJump(seed, 123456789 + 987654321ull));
+    CHECK(RNG::xorShiftJump(0, 12345) == 0u);
+  }
+
+  SUBCASE("Partitions hand out contiguous substreams")
+  {
+    const uint32_t seed = 2024;
+    const size_t workers = 8;
+    const uint64_t perWorker = 500;
+    auto starts = RNG::xorShiftPartition(seed, workers, perWorker);
+    REQUIRE(starts.size() == workers);
+
+    std::vector<uint32_t> serial, parallel;
+    uint32_t value = seed;
+    for (size_t i = 0; i < workers * perWorker; ++i)
+      serial.push_back(value = RNG::xorShift(value, 0, 0));
+    for (uint32_t start : starts)
+    {
+      value = start;
+      for (uint64_t i = 0; i < perWorker; ++i)
+        parallel.push_back(value = RNG::xorShift(value, 0, 0));
+    }
+    CHECK(parallel == serial);
+
+    CHECK_THROWS_AS(RNG::xorShiftPartition(seed, 2, RNG::XorShiftPeriod), std::invalid_argument);
+  }
+}
+
+TEST_CASE("RNG compile time generator")
+{
+  SUBCASE("XorShift32 follows xorShift")
+  {
+    RNG::XorShift32 generator(1);
+    uint32_t value = 1;
+    for (int i = 0; i < 1000; ++i)
+    {
+      value = RNG::xorShift(value, 0, 99);
+      REQUIRE(generator() == value);
+    }
+  }
+
+  SUBCASE("Tables are built at compile time")
+  {
+    constexpr auto table = RNG::xorShiftTable<4>(1);
+    static_assert(table[0] == 270369u);
+    static_assert(table[1] == RNG::XorShift32::step(table[0]));
+    static_assert(RNG::XorShift32::jump(1, 4) == table[3]);
+    CHECK(table[3] == RNG::xorShiftJump(1, 4));
+  }
+
+  SUBCASE("Works with the standard distributions")
+  {
+    static_assert(std::uniform_random_bit_generator<RNG::XorShift32>);
+    static_assert(std::uniform_random_bit_generator<RNG::XorShift<5, 9, 7>>);
+    RNG::XorShift32 generator(42);
+    std::uniform_int_distribution<int> dice(1, 6);
+    int counts[7] = {};
+    for (int i = 0; i < 60000; ++i)
+      counts[dice(generator)]++;
+    for (int face = 1; face <= 6; ++face)
+      CHECK(counts[face] > 9000);
+  }
+
+  SUBCASE("Zero seed and discard")
+  {
+    RNG::XorShift32 zero(0);
+    CHECK(zero() != 0u);
+
+    RNG::XorShift<5, 9, 7> stepped(99), skipped(99);
+    for (int i = 0; i < 777; ++i)
+      stepped();
+    skipped.discard(777);
+    CHECK(stepped == skipped);
+    CHECK(RNG::XorShift<5, 9, 7>::jump(99, 0xFFFFFFFFull) == 99u);
+  }
+}
+
+TEST_CASE("RNG bounded integers")
+{
+  SUBCASE("Modulo mode reproduces the README clamp")
+  {
+    RNG::XorShift32 generator(1);
+    CHECK(RNG::boundedRange<RNG::Bounded::Modulo>(generator, 99, 0) == 69);
+
+    uint32_t seed = 555;
+    RNG::XorShift32 same(seed);
+    for (int i = 0; i < 1000; ++i)
+    {
+      seed = RNG::xorShift(seed, -50, 50);
+      REQUIRE(RNG::boundedRange<RNG::Bounded::Modulo>(same, -50, 50) == -50 + static_cast<int>(seed % 101));
+    }
+  }
+
+  SUBCASE("Lemire values stay in range and are uniform")
+  {
+    RNG::XorShift32 generator(7);
+    const uint32_t range = 10;
+    int counts[range] = {};
+    for (int i = 0; i < 100000; ++i)
+    {
+      uint32_t value = RNG::bounded(generator, range);
+      REQUIRE(value < range);
+      counts[value]++;
+    }
+    for (int count : counts)
+      CHECK(std::abs(count - 10000) < 500);
+
+    CHECK(RNG::bounded(generator, 1) == 0u);
+    for (int i = 0; i < 1000; ++i)
+    {
+      int value = RNG::boundedRange(generator, 3, -3);
+      REQUIRE(value >= -3);
+      REQUIRE(value <= 3);
+    }
+  }
+
+  SUBCASE("Rejection removes the bias of large ranges")
+  {
+    // with range = 3 * 2^30, % returns values below 2^30 twice as often as the others
+    RNG::XorShift32 lemire(11), modulo(11);
+    const uint32_t range = 3u << 30;
+    int lemireLow = 0, moduloLow = 0;
+    for (int i = 0; i < 30000; ++i)
+    {
+      lemireLow += RNG::bounded(lemire, range) < (1u << 30);
+      moduloLow += RNG::bounded<RNG::Bounded::Modulo>(modulo, range) < (1u << 30);
+    }
+    CHECK(std::abs(lemireLow - 10000) < 500);
+    CHECK(std::abs(moduloLow - 15000) < 500);
+  }
+
+  SUBCASE("Batches are in range and reproducible")
+  {
+    const uint32_t range = 3u << 30;
+    RNG::XorShiftBulk first(3), second(3);
+    std::vector<uint32_t> a(5000), b(5000);
+    RNG::boundedFill(first, a, range);
+    RNG::boundedFill(second, b, range);
+    CHECK(a == b);
+    int low = 0;
+    for (uint32_t value : a)
+    {
+      REQUIRE(value < range);
+      low += value < (1u << 30);
+    }
+    CHECK(std::abs(low - 5000 / 3) < 150);
+
+    RNG::XorShiftBulk raw(4), modulo(4);
+    std::vector<uint32_t> expected(100), actual(100);
+    raw.fill(expected);
+    RNG::boundedFill<RNG::Bounded::Modulo>(modulo, actual, 7);
+    for (size_t i = 0; i < expected.size(); ++i)
+      CHECK(actual[i] == expected[i] % 7);
+  }
+}
+
+TEST_CASE("RNG real distributions")
+{
+  SUBCASE("Portable functions match the standard library")
+  {
+    for (double x : {-30.0, -5.5, -1.0, -1e-3, 0.0, 0.25, 1.0, 3.0, 20.0})
+      CHECK(RNG::Portable::exp(x) == doctest::Approx(std::exp(x)).epsilon(1e-14));
+    for (double x : {1e-300, 1e-9, 0.1, 0.5, 1.0, 2.0, 1234.5, 1e200})
+      CHECK(RNG::Portable::log(x) == doctest::Approx(std::log(x)).epsilon(1e-14));
+    for (double x : {1e-10, 0.5, 2.0, 1e10})
+      CHECK(RNG::Portable::sqrt(x) == doctest::Approx(std::sqrt(x)).epsilon(1e-15));
+    static_assert(RNG::Portable::exp(0) == 1.0);
+  }
+
+  SUBCASE("Unit reals are exact scalings of the high bits")
+  {
+    static_assert(RNG::toUnitFloat(0) == 0.0f);
+    static_assert(RNG::toUnitFloat(0x80000000u) == 0.5f);
+    static_assert(RNG::toUnitFloat(0xFFFFFFFFu) < 1.0f);
+    static_assert(RNG::toUnitDouble(0xFFFFFFFFFFFFFFFFull) < 1.0);
+    static_assert(RNG::toUnitDouble(0x4000000000000000ull) == 0.25);
+
+    RNG::XorShift32 generator(3);
+    double sum = 0;
+    for (int i = 0; i < 100000; ++i)
+    {
+      float f = RNG::uniform<float>(generator);
+      double d = RNG::uniform<double>(generator);
+      REQUIRE(f >= 0.0f);
+      REQUIRE(f < 1.0f);
+      REQUIRE(d >= 0.0);
+      REQUIRE(d < 1.0);
+      sum += d;
+    }
+    CHECK(sum / 100000 == doctest::Approx(0.5).epsilon(0.01));
+  }
+
+  SUBCASE("Ziggurat tables")
+  {
+    constexpr auto &t = RNG::Ziggurat::tables;
+    static_assert(t.f[0] == 1.0);
+    static_assert(t.k[1] == 0);
+    for (size_t i = 2; i < RNG::Ziggurat::Boxes; ++i)
+      CHECK(t.w[i] > t.w[i - 1]);
+    // the construction closes the stack of boxes at the top of the density
+    CHECK(t.w[1] * 2147483648.0 < 0.3);
+  }
+
+  SUBCASE("Normal moments and tail")
+  {
+    RNG::XorShift32 generator(2024);
+    const int n = 1000000;
+    double sum = 0, squares = 0, fourth = 0;
+    int beyondR = 0;
+    for (int i = 0; i < n; ++i)
+    {
+      double x = RNG::normal(generator);
+      sum += x;
+      squares += x * x;
+      fourth += x * x * x * x;
+      beyondR += std::abs(x) > RNG::Ziggurat::R;
+    }
+    CHECK(std::abs(sum / n) < 0.005);
+    CHECK(squares / n == doctest::Approx(1.0).epsilon(0.01));
+    CHECK(fourth / n == doctest::Approx(3.0).epsilon(0.03));
+    // 2 * (1 - Phi(3.4426)) is about 5.76e-4
+    CHECK(std::abs(beyondR - 576) < 100);
+  }
+
+  SUBCASE("Known answers are the same on every compiler")
+  {
+    RNG::XorShift32 generator(1);
+    CHECK(RNG::uniform<float>(generator) == 0x1.08p-14f);
+    constexpr double first = []()
+    {
+      RNG::XorShift32 g(12345);
+      return RNG::normal(g);
+    }();
+    RNG::XorShift32 runtime(12345);
+    CHECK(RNG::normal(runtime) == first);
+
+    // literal bits, so a compiler that rounds differently, for example by fusing multiply adds, fails here
+    CHECK(first == -0x1.426bf853f53b1p+0);
+    CHECK(RNG::normal(runtime) == 0x1.07dd6e0fff64ap+0);
+    CHECK(RNG::normal(runtime) == -0x1.80ff615f3b214p-1);
+    CHECK(RNG::normal(runtime) == 0x1.047725e6b502ep+1);
+    // enough draws to go through the wedges and the tail many times, any bit that changes shows in the sum
+    RNG::XorShift32 many(2024);
+    double sum = 0;
+    for (int i = 0; i < 100000; ++i)
+      sum += RNG::normal(many);
+    CHECK(sum == -0x1.1211c70e335bap+6);
+    // and the Portable functions at runtime, on arguments the compiler cannot fold
+    volatile double arguments[] = {-1.7, -0.3, 3.3, 0.01};
+    CHECK(RNG::Portable::exp(arguments[0]) == 0x1.7622c78a98a08p-3);
+    CHECK(RNG::Portable::exp(arguments[1]) == 0x1.7b4c869c37c04p-1);
+    CHECK(RNG::Portable::log(arguments[2]) == 0x1.31a4e7240c777p+0);
+    CHECK(RNG::Portable::log(arguments[3]) == -0x1.26bb1bbb55515p+2);
+    CHECK(RNG::Ziggurat::tables.f[64] == 0x1.3c2c88fdb8ddfp-2);
+    CHECK(RNG::Ziggurat::tables.w[64] == 0x1.887872788109ep-31);
+  }
+
+  SUBCASE("Batches follow the scalar samplers")
+  {
+    RNG::XorShiftBulk batch(9), single(9);
+    std::vector<double> values(4000);
+    RNG::normalFill<double>(batch, values, 10.0, 2.0);
+    double sum = 0;
+    for (double value : values)
+      sum += value;
+    CHECK(sum / values.size() == doctest::Approx(10.0).epsilon(0.01));
+
+    std::vector<float> uniforms(1000);
+    RNG::uniformFill<float>(single, uniforms);
+    RNG::XorShiftBulk again(9);
+    for (float value : uniforms)
+      REQUIRE(value == RNG::uniform<float>(again));
+  }
+}
+
+TEST_CASE("RNG counter based generator")
+{
+  using Philox = RNG::Philox4x32;
+
+  SUBCASE("Known answers")
+  {
+    static_assert(Philox::block({0, 0, 0, 0}, {0, 0}) == Philox::Counter{0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u});
+    CHECK(Philox::block({0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}, {0xffffffffu, 0xffffffffu}) ==
+          Philox::Counter{0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu});
+    CHECK(Philox::block({0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}, {0xa4093822u, 0x299f31d0u}) ==
+          Philox::Counter{0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u});
+  }
+
+  SUBCASE("Fill is the sequence of blocks, however it is split")
+  {
+    const auto key = Philox::key(0x0123456789ABCDEFull);
+    std::vector<uint32_t> whole(1002);
+    Philox::fill(key, 100, whole, 7);
+    for (size_t i = 0; i < whole.size(); ++i)
+      REQUIRE(whole[i] == Philox::block(Philox::counterOf(100 + i / 4, 7), key)[i % 4]);
+
+    // two halves computed separately, as two threads would
+    std::vector<uint32_t> first(500), second(502);
+    Philox::fill(key, 100, first, 7);
+    Philox::fill(key, 225, second, 7);
+    first.insert(first.end(), second.begin(), second.end());
+    CHECK(first == whole);
+  }
+
+  SUBCASE("Streams only depend on their key and counter")
+  {
+    const auto key = Philox::key(42);
+    Philox::Stream agent3(key, 3), agent4(key, 4), again(key, 3);
+    std::vector<uint32_t> a, b;
+    for (int i = 0; i < 50; ++i)
+    {
+      a.push_back(agent3());
+      agent4();
+      b.push_back(again());
+    }
+    CHECK(a == b);
+
+    Philox::Stream stream(key, 3), copy(key, 3);
+    CHECK(RNG::normal(stream) == RNG::normal(copy));
+    CHECK(RNG::bounded(stream, 6) < 6u);
+    CHECK(Philox::Stream(key, 3, 1)() == Philox::block(Philox::counterOf(0, uint64_t(1) << 32 | 3), key)[0]);
+  }
+
+  SUBCASE("Consecutive frames and agents draw disjoint values")
+  {
+    const auto key = Philox::key(42);
+    auto draws = [&](uint32_t agent, uint32_t frame)
+    {
+      Philox::Stream stream(key, agent, frame);
+      std::vector<uint32_t> values(64);
+      for (auto &value : values)
+        value = stream();
+      std::sort(values.begin(), values.end());
+      return values;
+    };
+    auto disjoint = [](const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+    {
+      std::vector<uint32_t> common;
+      std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(common));
+      return common.empty();
+    };
+    for (uint32_t frame = 10; frame < 13; ++frame)
+    {
+      CHECK(disjoint(draws(3, frame), draws(3, frame + 1)));
+      CHECK(disjoint(draws(3, frame), draws(4, frame)));
+    }
+  }
+}
+
+// bits of a '0'/'1' string packed least significant first, the order the battery reads them in
+static std::vector<uint32_t> packBits(const std::string &bits)
+{
+  std::vector<uint32_t> values((bits.size() + 31) / 32, 0);
+  for (size_t i = 0; i < bits.size(); ++i)
+    values[i / 32] |= uint32_t(bits[i] == '1') << (i % 32);
+  return values;
+}
+
+TEST_CASE("RNG quality battery")
+{
+  using namespace RNG::Battery;
+
+  SUBCASE("Runs test matches the NIST SP 800-22 examples")
+  {
+    // section 2.3.4: V = 7, pi = 0.6, P-value = 0.147232
+    const Result small = runs(packBits("1001101011"), 10);
+    CHECK(small.statistic == doctest::Approx((7 - 4.8) / (2 * std::sqrt(10.0) * 0.24)));
+    CHECK(*small.pValue == doctest::Approx(0.147232).epsilon(1e-5));
+    CHECK(small.passed);
+
+    // section 2.3.8: V = 52, pi = 0.42, P-value = 0.500798
+    const std::string bits = "1100100100001111110110101010001000100001011010001100001000110100110001001100011001100010100010111000";
+    const Result large = runs(packBits(bits), bits.size());
+    CHECK(*large.pValue == doctest::Approx(0.500798).epsilon(1e-5));
+  }
+
+  SUBCASE("Runs test fails sequences that fail the frequency pre-test")
+  {
+    // pi = 0.75 over 64 bits, out of |pi - 1/2| < 2 / 8
+    const Result biased = runs({0xFFFFFFFFu, 0x0000FFFFu});
+    CHECK(*biased.pValue == 0);
+    CHECK_FALSE(biased.passed);
+    // alternating bits: the most runs possible for pi = 1/2
+    CHECK_FALSE(runs(std::vector<uint32_t>(64, 0x55555555u)).passed);
+  }
+
+  SUBCASE("Linear complexity of GF(2) linear generators is their state size")
+  {
+    std::vector<uint32_t> values(4000);
+    uint32_t seed = 1;
+    for (uint32_t &value : values)
+      value = seed = RNG::xorShift(seed, 0, 0);
+    const Result linear = linearComplexity(values, 32);
+    CHECK(linear.statistic == 32);
+    CHECK_FALSE(linear.pValue);
+    CHECK(linear.passed);
+    CHECK_FALSE(linearComplexity(values, 64).passed);
+
+    RNG::Philox4x32::fill(RNG::Philox4x32::key(1), 0, values);
+    CHECK(linearComplexity(values).passed);
+  }
+}